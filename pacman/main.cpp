@@ -1,19 +1,51 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <mutex>
+#include <new>
 #include <random>
-#include <sys/fcntl.h>   // for making stdin non-blocking
-#include <sys/poll.h>    // IO multiplexing
+#include <string>
+#include <sys/epoll.h>    // waiting on stdin and the frame timer together
+#include <sys/resource.h> // peak memory for the headless report
 #include <sys/termios.h> // interacting with terminal
+#include <sys/timerfd.h> // the fixed timestep
+#include <thread>
 #include <tuple>
-#include <unistd.h> // For usleep function
-#include <unordered_map>
-#include <unordered_set>
+#include <unistd.h> // read, write and close on the fds, usleep for the countdown
 #include <utility>
 #include <vector>
 
+// Every heap allocation in the program comes through here, so headless
+// runs can show that a tick allocates nothing once it is warmed up.
+std::atomic< long > heapAllocations (0);
+
+void* operator new (std::size_t size) {
+    heapAllocations.fetch_add (1, std::memory_order_relaxed);
+    if (void* p = std::malloc (size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc ();
+}
+
+void operator delete (void* p) noexcept {
+    std::free (p);
+}
+
+void operator delete (void* p, std::size_t) noexcept {
+    std::free (p);
+}
+
 const char PACMAN    = 'O';
 const char COLUMN    = 'I';
 const char ADD_GHOST = ' '; // spacebar
@@ -24,51 +56,102 @@ const char LEFT_CMD  = 'a';
 const char RIGHT_CMD = 'd';
 
 // Decides how many FPS to update
-const int FRAME                              = 100000;
-const int SECOND                             = 1000000;
-const int NON_BLOCKING_EVENT_LOOP_INPUT_POLL = 0;
+const int FRAME  = 100000;
+const int SECOND = 1000000;
+// a late timer wake runs at most this many missed ticks before drawing
+const int MAX_CATCH_UP_TICKS = 5;
+
+// Hands out the seeds for every RandGen. Seeded from std::random_device
+// for normal play, or from one fixed seed so a whole run can be replayed.
+class Seeder {
+    public:
+    Seeder ();
+    explicit Seeder (std::uint64_t seed);
+    std::uint32_t next ();
+
+    private:
+    std::mt19937_64 gen;
+};
+
+Seeder::Seeder () : gen (std::random_device{}()) {
+}
 
-// making it a class to avoid reconstructing distribution on every call
+Seeder::Seeder (std::uint64_t seed) : gen (seed) {
+}
+
+std::uint32_t Seeder::next () {
+    return static_cast< std::uint32_t > (this->gen ());
+}
+
+// xoshiro128** over [lower, upper]. The whole state is 16 bytes kept
+// in place, seeded from the run's Seeder through splitmix64, so a ghost
+// costs no heap allocation and no read of the entropy device.
 class RandGen {
     public:
-    RandGen (int lower, int upper);
+    RandGen (int lower, int upper, Seeder& seeder);
     int getRandomInt ();
 
-    // delete copy and move
-    RandGen (const RandGen&)            = delete;
-    RandGen& operator= (const RandGen&) = delete;
-    RandGen (RandGen&&)                 = delete;
-    RandGen& operator= (RandGen&&)      = delete;
-
     private:
-    std::unique_ptr< std::random_device > dev;
-    std::unique_ptr< std::mt19937 > gen;
-    std::unique_ptr< std::uniform_int_distribution< int > > distribution;
-};
+    std::uint32_t state[4];
+    int lower;
+    std::uint32_t span;
 
-RandGen::RandGen (int lower, int upper) {
-    // Create a random device to obtain seed
-    this->dev = std::make_unique< std::random_device > ();
+    std::uint32_t next ();
+};
 
-    // Create a random number generator using the seed from the random device
-    this->gen = std::make_unique< std::mt19937 > ((*this->dev) ());
+RandGen::RandGen (int lower, int upper, Seeder& seeder)
+: lower (lower), span (static_cast< std::uint32_t > (upper - lower) + 1) {
+    std::uint64_t x = seeder.next ();
+    for (int i = 0; i < 4; i += 2) {
+        // splitmix64, never leaves the state all zero
+        std::uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z               = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z               = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z               = z ^ (z >> 31);
+        this->state[i]     = static_cast< std::uint32_t > (z);
+        this->state[i + 1] = static_cast< std::uint32_t > (z >> 32);
+    }
+}
 
-    // Define the distribution for integers in the range [lower, upper]
-    this->distribution =
-    std::make_unique< std::uniform_int_distribution< int > > (lower, upper);
+std::uint32_t RandGen::next () {
+    std::uint32_t* s     = this->state;
+    std::uint32_t x      = s[1] * 5;
+    std::uint32_t result = ((x << 7) | (x >> 25)) * 9;
+    std::uint32_t t      = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+    return result;
 }
 
 int RandGen::getRandomInt () {
-    // Generate a random integer
-    return (*this->distribution) (*this->gen);
+    // Lemire's multiply and shift, rejecting the few values that would bias it
+    std::uint64_t m = static_cast< std::uint64_t > (this->next ()) * this->span;
+    if (static_cast< std::uint32_t > (m) < this->span) {
+        std::uint32_t threshold = -this->span % this->span;
+        while (static_cast< std::uint32_t > (m) < threshold) {
+            m = static_cast< std::uint64_t > (this->next ()) * this->span;
+        }
+    }
+    return this->lower + static_cast< int > (m >> 32);
+}
+
+// cursor home and erase the screen, instead of forking a shell to run clear
+const char CLEAR_SCREEN[] = "\x1b[H\x1b[2J";
+
+void clearScreen () {
+    std::cout << CLEAR_SCREEN << std::flush;
 }
 
 void runCountdown (int i) {
-    system ("clear");
+    clearScreen ();
     for (int j = i; j >= 0; j--) {
         std::cout << j << " seconds to go!" << std::endl;
         usleep (SECOND);
-        system ("clear");
+        clearScreen ();
     }
 }
 
@@ -83,14 +166,13 @@ enum Direction {
 struct Input {
     int moverId;
     Direction dir;
+    Input () : moverId (0), dir (NOOP){};
     Input (int id, Direction iDir) : moverId (id), dir (iDir){};
 };
 
-struct Position {
-    int x;
-    int y;
-    Direction dir;
-};
+// row and column step of a move, indexed by Direction
+const int dirRowStep[4] = { -1, 1, 0, 0 };
+const int dirColStep[4] = { 0, 0, 1, -1 };
 
 enum CollisionValidation {
     NOCOLLISION,
@@ -117,9 +199,17 @@ class ScoreKeeper {
         }
     }
 
-    void displayScore () {
-        std::cout << "Ghosts On Screen: " << numGhosts << "\n"
-                  << "Times Caught: " << timesCaught << "\n";
+    void displayScore (std::vector< std::string >& lines) {
+        lines.push_back ("Ghosts On Screen: " + std::to_string (numGhosts));
+        lines.push_back ("Times Caught: " + std::to_string (timesCaught));
+    }
+
+    int ghosts () const {
+        return numGhosts;
+    }
+
+    int caught () const {
+        return timesCaught;
     }
 
     private:
@@ -127,64 +217,204 @@ class ScoreKeeper {
     int timesCaught;
 };
 
+// One bit per cell of a row major board, set where there is a wall. At
+// an eighth of the board's size it stays in cache on boards whose chars
+// would not, and wall checks are all the ghosts and the BFS need.
+class WallMask {
+    public:
+    explicit WallMask (int cells);
+    void set (int cell);
+    void clear (int cell);
+    bool test (int cell) const;
+
+    private:
+    std::vector< std::uint64_t > words;
+};
+
+WallMask::WallMask (int cells) : words ((cells + 63) / 64, 0) {
+}
+
+void WallMask::set (int cell) {
+    this->words[cell >> 6] |= std::uint64_t (1) << (cell & 63);
+}
+
+void WallMask::clear (int cell) {
+    this->words[cell >> 6] &= ~(std::uint64_t (1) << (cell & 63));
+}
+
+bool WallMask::test (int cell) const {
+    return (this->words[cell >> 6] >> (cell & 63)) & 1;
+}
+
+// From 5 moves away the ghost will start chasing you!
+const int BFS_DEPTH_GHOST = 5;
+
+// Moves from pacman to every cell within a radius, walls block and
+// everything else does not. It is one flat array the size of the board,
+// filled by a single BFS per tick and read by every ghost, so chasing
+// costs four reads per ghost instead of a search per ghost.
+class DistanceField {
+    public:
+    // radius 0 covers the whole board
+    DistanceField (int rows, int cols, int radius);
+    // BFS from (srcRow, srcCol), or clear the field when srcRow is -1
+    void compute (const WallMask& walls, int srcRow, int srcCol);
+    // moves to the source, -1 when walled off or beyond the radius
+    int distance (int row, int col) const;
+    // The first direction in UP, DOWN, RIGHT, LEFT order whose neighbour is
+    // closest to the source, NOOP when no neighbour is in the field. The
+    // cell itself is not read, a ghost can stand on a wall it spawned into.
+    Direction towardsSource (int row, int col) const;
+
+    private:
+    int rows;
+    int cols;
+    int radius;
+    std::vector< int > dist;
+    // cells of the last BFS in visiting order, reset before the next one
+    std::vector< int > visited;
+};
+
+DistanceField::DistanceField (int rows, int cols, int radius)
+: rows (rows), cols (cols), radius (radius > 0 ? radius : rows * cols),
+  dist (rows * cols, -1) {
+}
+
+void DistanceField::compute (const WallMask& walls, int srcRow, int srcCol) {
+    for (int cell : this->visited) {
+        this->dist[cell] = -1;
+    }
+    this->visited.clear ();
+    if (srcRow < 0) {
+        return;
+    }
+
+    this->dist[srcRow * this->cols + srcCol] = 0;
+    this->visited.push_back (srcRow * this->cols + srcCol);
+    // visited doubles as the queue
+    for (size_t head = 0; head < this->visited.size (); head++) {
+        int cell = this->visited[head];
+        int d    = this->dist[cell];
+        if (d == this->radius) {
+            continue;
+        }
+        int row = cell / this->cols;
+        int col = cell % this->cols;
+        for (int dir = 0; dir < 4; dir++) {
+            int nrow = row + dirRowStep[dir];
+            int ncol = col + dirColStep[dir];
+            if (nrow < 0 || nrow >= this->rows || ncol < 0 || ncol >= this->cols) {
+                continue;
+            }
+            int ncell = nrow * this->cols + ncol;
+            if (this->dist[ncell] >= 0 || walls.test (ncell)) {
+                continue;
+            }
+            this->dist[ncell] = d + 1;
+            this->visited.push_back (ncell);
+        }
+    }
+}
+
+int DistanceField::distance (int row, int col) const {
+    return this->dist[row * this->cols + col];
+}
+
+Direction DistanceField::towardsSource (int row, int col) const {
+    Direction best = NOOP;
+    int bestDist   = -1;
+    for (int i = 0; i < 4; i++) {
+        int nrow = row + dirRowStep[i];
+        int ncol = col + dirColStep[i];
+        if (nrow < 0 || nrow >= this->rows || ncol < 0 || ncol >= this->cols) {
+            continue;
+        }
+        int d = this->distance (nrow, ncol);
+        if (d >= 0 && (bestDist < 0 || d < bestDist)) {
+            best     = (Direction)i;
+            bestDist = d;
+        }
+    }
+    return best;
+}
+
 // forward decl
 class Ghost;
 
 class Gameboard {
     public:
-    Gameboard (int rows, int cols, ScoreKeeper& scoreKeeper);
+    Gameboard (int rows, int cols, ScoreKeeper& scoreKeeper, Seeder& seeder, int chaseRadius);
     void drawWalls (int percentage);
-    void draw (std::vector< std::unique_ptr< Input > >& updates);
+    // apply the moves and mark every movable on the board
+    void update (std::vector< Input >& updates);
     int insertMovable ();
+    int rowCount () const;
+    int colCount () const;
+    char cellAt (int row, int col) const;
+    // hash of every movable's position and direction, equal for equal runs
+    std::uint64_t checksum () const;
+    // bring the distance field up to date with pacman, once per tick before ghosts plan
+    void refreshField ();
+    long fieldRebuilds () const;
 
     private:
-    std::vector< std::vector< char > > board;
     int rows;
     int cols;
+    // one row major grid, cell (row, col) at row * cols + col
+    std::vector< char > board;
+    // the COLUMN cells of board
+    WallMask walls;
     int pidCounter;
-    std::vector< std::unique_ptr< Position > > movables;
-    std::unique_ptr< RandGen > rowRandGen;
-    std::unique_ptr< RandGen > colRandGen;
+    // position and facing of every movable by id, pacman is 0
+    std::vector< int > movableX;
+    std::vector< int > movableY;
+    std::vector< Direction > movableDir;
+    RandGen rowRandGen;
+    RandGen colRandGen;
     // just hold a reference because this was allocated on stack and DI'd
     ScoreKeeper& keeper;
-
-    std::pair< int, int > getCurrPos (int pid);
-
-    // update and get prev position
-    std::pair< int, int > updateMovable (const Input& input);
-
-    std::pair< std::pair< int, int >, Direction >
-    validateMoveBoundary (std::pair< int, int >& currPos, Direction dir);
-    CollisionValidation validateCollision (std::pair< int, int >& currPos,
-    std::pair< int, int >& offset);
+    Seeder& seeder;
+
+    // Pacman only shows on the board while no ghost stands on him, and the
+    // field follows what is on the board. It is rebuilt only when his cell,
+    // his visibility or the walls changed since the last build.
+    DistanceField field;
+    int fieldSourceRow;
+    int fieldSourceCol;
+    bool fieldBuilt;
+    // bumped when a wall cell is lost to a movable spawned on it
+    long wallsVersion;
+    long fieldWallsVersion;
+    long rebuilds;
+
+    // update and get the cell left behind, -1 when the move was invalid
+    int updateMovable (const Input& input);
+
+    // the cell a move from (row, col) lands on, -1 when it leaves the board
+    int validateMoveBoundary (int row, int col, Direction dir) const;
+    CollisionValidation validateCollision (int cell) const;
+    // true when every neighbour of (row, col) is a wall or off the board
+    bool boxedIn (int row, int col) const;
 
     friend class Ghost;
 };
 
-std::pair< int, int > Gameboard::getCurrPos (int pid) {
-    const Position& pos = *this->movables[pid];
-    return std::make_pair (pos.y, pos.x);
-}
-
-Gameboard::Gameboard (int rows, int cols, ScoreKeeper& scoreKeeper)
-: rows (rows), cols (cols), pidCounter (0),
-  rowRandGen (std::make_unique< RandGen > (0, rows - 1)),
-  colRandGen (std::make_unique< RandGen > (0, cols - 1)), keeper (scoreKeeper) {
-    // construct graph super simple
-    for (int i = 0; i < rows; i++) {
-        std::vector< char > row (cols, ' ');
-        this->board.push_back (row);
-    }
+Gameboard::Gameboard (int rows, int cols, ScoreKeeper& scoreKeeper, Seeder& seeder, int chaseRadius)
+: rows (rows), cols (cols), board (rows * cols, ' '), walls (rows * cols), pidCounter (0),
+  rowRandGen (0, rows - 1, seeder), colRandGen (0, cols - 1, seeder), keeper (scoreKeeper),
+  seeder (seeder), field (rows, cols, chaseRadius), fieldSourceRow (-1), fieldSourceCol (-1),
+  fieldBuilt (false), wallsVersion (0), fieldWallsVersion (0), rebuilds (0) {
 }
 
 // This would be nice if we made it into mazes
 void Gameboard::drawWalls (int percentage) {
-    RandGen decisionRg (1, 100);
+    RandGen decisionRg (1, 100, this->seeder);
 
     for (int i = 0; i < this->rows; i++) {
         for (int j = 0; j < this->cols; j++) {
             if (i != 0 && j != 0 && decisionRg.getRandomInt () < percentage) {
-                this->board[i][j] = COLUMN;
+                this->board[i * this->cols + j] = COLUMN;
+                this->walls.set (i * this->cols + j);
             }
         }
     }
@@ -192,44 +422,84 @@ void Gameboard::drawWalls (int percentage) {
 
 const char ghostDir[5] = { 'v', '^', '<', '>', '<' };
 
-void Gameboard::draw (std::vector< std::unique_ptr< Input > >& updates) {
+void Gameboard::update (std::vector< Input >& updates) {
     // go over the updates, make the updates and mark the inverse as empty
     for (auto i = 0u; i < updates.size (); i++) {
-        const Input& update           = *updates[i];
-        std::pair< int, int > prevPos = this->updateMovable (update);
-        // we know the pos on board will never go to -1 unless the move was invalid
-        if (prevPos.first == -1 || prevPos.second == -1) {
+        int prevCell = this->updateMovable (updates[i]);
+        // we know the cell will never be -1 unless the move was invalid
+        if (prevCell == -1) {
             continue;
         }
-        // when someone has passed over the cell is now empty
-        this->board[prevPos.first][prevPos.second] = ' ';
+        // when someone has passed over the cell is now empty, even a
+        // wall that a ghost spawned into
+        if (this->board[prevCell] == COLUMN) {
+            this->walls.clear (prevCell);
+            this->wallsVersion++;
+        }
+        this->board[prevCell] = ' ';
     }
 
     for (int i = 0; i < pidCounter; i++) {
-        const Position& pos = *this->movables[i];
-
         char repr;
         if (i == 0) {
             repr = PACMAN;
         } else {
             // based on the dir we should get the ghost char
-            repr = ghostDir[pos.dir];
+            repr = ghostDir[this->movableDir[i]];
         }
 
-        this->board[pos.y][pos.x] = repr;
+        int cell = this->movableY[i] * this->cols + this->movableX[i];
+        if (this->board[cell] == COLUMN) {
+            this->walls.clear (cell);
+            this->wallsVersion++;
+        }
+        this->board[cell] = repr;
     }
+}
 
-    int strBoardSize = this->rows * this->cols;
-    std::string strBoard;
-    strBoard.reserve (strBoardSize);
-    for (int i = 0; i < this->rows; i++) {
-        for (int j = 0; j < this->cols; j++) {
-            strBoard.push_back (this->board[i][j]);
-        }
-        strBoard.push_back ('\n');
+int Gameboard::rowCount () const {
+    return this->rows;
+}
+
+int Gameboard::colCount () const {
+    return this->cols;
+}
+
+char Gameboard::cellAt (int row, int col) const {
+    return this->board[row * this->cols + col];
+}
+
+void Gameboard::refreshField () {
+    int pacmanRow = this->movableY[0];
+    int pacmanCol = this->movableX[0];
+    bool visible  = this->board[pacmanRow * this->cols + pacmanCol] == PACMAN;
+    int srcRow    = visible ? pacmanRow : -1;
+    int srcCol    = visible ? pacmanCol : -1;
+    if (this->fieldBuilt && srcRow == this->fieldSourceRow &&
+    srcCol == this->fieldSourceCol && this->wallsVersion == this->fieldWallsVersion) {
+        return;
     }
+    this->field.compute (this->walls, srcRow, srcCol);
+    this->fieldSourceRow    = srcRow;
+    this->fieldSourceCol    = srcCol;
+    this->fieldWallsVersion = this->wallsVersion;
+    this->fieldBuilt        = true;
+    this->rebuilds++;
+}
+
+long Gameboard::fieldRebuilds () const {
+    return this->rebuilds;
+}
 
-    std::cout << strBoard;
+std::uint64_t Gameboard::checksum () const {
+    // FNV-1a over (x, y, dir) of every movable
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < this->pidCounter; i++) {
+        for (int v : { this->movableX[i], this->movableY[i], (int)this->movableDir[i] }) {
+            hash = (hash ^ (std::uint32_t)v) * 1099511628211ULL;
+        }
+    }
+    return hash;
 }
 
 int Gameboard::insertMovable () {
@@ -237,58 +507,46 @@ int Gameboard::insertMovable () {
     int col = 0;
 
     if (this->pidCounter != 0) {
-        row = this->rowRandGen->getRandomInt ();
-        col = this->colRandGen->getRandomInt ();
+        row = this->rowRandGen.getRandomInt ();
+        col = this->colRandGen.getRandomInt ();
     }
 
-    this->movables.push_back (std::make_unique< Position > (Position{ col, row, NOOP }));
+    this->movableX.push_back (col);
+    this->movableY.push_back (row);
+    this->movableDir.push_back (NOOP);
     this->pidCounter++;
 
     // the movable Id for the newly inserted movable
     return this->pidCounter - 1;
 }
 
-std::pair< std::pair< int, int >, Direction >
-Gameboard::validateMoveBoundary (std::pair< int, int >& currPos, Direction dir) {
-    Direction res                = NOOP;
-    std::pair< int, int > offset = std::make_pair (0, 0);
+int Gameboard::validateMoveBoundary (int row, int col, Direction dir) const {
     // Bounds checking
     switch (dir) {
     case UP:
-        if (currPos.first <= 0)
-            return std::make_pair (offset, res);
-        offset.first--;
-        res = UP;
+        if (row <= 0)
+            return -1;
         break;
     case DOWN:
-        if (currPos.first >= rows - 1)
-            return std::make_pair (offset, res);
-        offset.first++;
-        res = DOWN;
+        if (row >= rows - 1)
+            return -1;
         break;
     case LEFT:
-        if (currPos.second <= 0)
-            return std::make_pair (offset, res);
-        offset.second--;
-        res = LEFT;
+        if (col <= 0)
+            return -1;
         break;
     case RIGHT:
-        if (currPos.second >= cols - 1)
-            return std::make_pair (offset, res);
-        offset.second++;
-        res = RIGHT;
+        if (col >= cols - 1)
+            return -1;
         break;
-    default: return std::make_pair (offset, res);
+    default: return -1;
     }
 
-    return std::make_pair (offset, res);
+    return (row + dirRowStep[dir]) * this->cols + col + dirColStep[dir];
 }
 
-CollisionValidation Gameboard::validateCollision (std::pair< int, int >& currPos,
-std::pair< int, int >& offset) {
-    std::pair< int, int > newPos =
-    std::make_pair (currPos.first + offset.first, currPos.second + offset.second);
-    char tile = this->board[newPos.first][newPos.second];
+CollisionValidation Gameboard::validateCollision (int cell) const {
+    char tile = this->board[cell];
     if (tile == ' ') {
         return NOCOLLISION;
     } else if (tile == PACMAN) {
@@ -300,24 +558,30 @@ std::pair< int, int >& offset) {
     return MOVABLECOL;
 }
 
-std::pair< int, int > Gameboard::updateMovable (const Input& input) {
-    // Take mutable reference of movable pos, without taking ownership of it
-    Position& movablePos          = *this->movables[input.moverId];
-    std::pair< int, int > initPos = std::make_pair (movablePos.y, movablePos.x);
+bool Gameboard::boxedIn (int row, int col) const {
+    for (int dir = 0; dir < 4; dir++) {
+        int cell = this->validateMoveBoundary (row, col, (Direction)dir);
+        if (cell >= 0 && !this->walls.test (cell)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    std::pair< std::pair< int, int >, Direction > validationRes =
-    this->validateMoveBoundary (initPos, input.dir);
+int Gameboard::updateMovable (const Input& input) {
+    int row  = this->movableY[input.moverId];
+    int col  = this->movableX[input.moverId];
+    int cell = this->validateMoveBoundary (row, col, input.dir);
 
-    if (validationRes.second == NOOP) {
-        return std::make_pair< int, int > (-1, -1);
+    if (cell == -1) {
+        return -1;
     }
 
-    std::pair< int, int > offset = validationRes.first;
-    CollisionValidation collValidation = this->validateCollision (initPos, offset);
+    CollisionValidation collValidation = this->validateCollision (cell);
 
     if (collValidation == COLUMNCOL) {
         // cannot proceed
-        return std::make_pair< int, int > (-1, -1);
+        return -1;
     } else if (collValidation == PACMANCOL && input.moverId != 0) {
         // movable ghost collided into pacman!
         this->keeper.notify (CAUGHT);
@@ -326,188 +590,536 @@ std::pair< int, int > Gameboard::updateMovable (const Input& input) {
         this->keeper.notify (CAUGHT);
     }
 
-    movablePos.dir = input.dir;
+    this->movableDir[input.moverId] = input.dir;
+    this->movableY[input.moverId]   = row + dirRowStep[input.dir];
+    this->movableX[input.moverId]   = col + dirColStep[input.dir];
 
-    movablePos.y += offset.first;
-    movablePos.x += offset.second;
-
-    return initPos;
+    return row * this->cols + col;
 }
 
-class Ghost {
+// bytes and write() calls the renderer has put out, summed over frames
+struct RenderStats {
+    long frames;
+    long bytes;
+    long syscalls;
+    long cellsChanged;
+};
+
+// Draws the board and a few status lines under it on an ANSI terminal.
+// It remembers what is on screen and only emits the cells that changed
+// since the last frame, each run of changed cells behind one cursor
+// move. A frame is built in one buffer and goes out in one write().
+class Renderer {
     public:
-    Ghost (int id);
-    std::unique_ptr< Input > getNextMove (Gameboard& gb);
+    explicit Renderer (int fd);
+    // leaves the cursor under the last frame and shows it again
+    ~Renderer ();
+
+    Renderer (const Renderer&)            = delete;
+    Renderer& operator= (const Renderer&) = delete;
+
+    void drawFrame (const Gameboard& gb, const std::vector< std::string >& status);
+    RenderStats stats () const;
+    // bytes and syscalls of the last frame, for the status lines
+    std::string lastFrameReadout () const;
 
     private:
-    int id;
-    Direction lastMove;
-    std::unique_ptr< RandGen > rg;
-    std::unique_ptr< RandGen > randomDirRg;
+    int fd;
+    int rows;
+    int cols;
+    // what the terminal shows, row major
+    std::vector< char > screen;
+    std::vector< std::string > screenStatus;
+    std::string out;
+    // where the terminal cursor is, -1 when unknown
+    int cursorRow;
+    int cursorCol;
+    RenderStats totals;
+    long lastBytes;
+    long lastSyscalls;
+
+    void moveTo (int row, int col);
+    void flush ();
 };
 
-const Direction dirFrom[4] = { UP, DOWN, LEFT, RIGHT };
+Renderer::Renderer (int fd)
+: fd (fd), rows (0), cols (0), cursorRow (-1), cursorCol (-1), totals{ 0, 0, 0, 0 },
+  lastBytes (0), lastSyscalls (0) {
+}
 
-Ghost::Ghost (int id) : id (id) {
-    this->rg          = std::make_unique< RandGen > (0, 3);
-    this->randomDirRg = std::make_unique< RandGen > (1, 100);
-    this->lastMove    = dirFrom[this->rg->getRandomInt ()];
+Renderer::~Renderer () {
+    if (this->rows > 0) {
+        this->moveTo (this->rows + (int)this->screenStatus.size (), 0);
+    }
+    // show the cursor again
+    this->out += "\x1b[?25h";
+    this->flush ();
 }
 
-struct BfsNode {
-    std::pair< int, int > currPos;
-    int level;
-    Direction initDirection;
-};
+void Renderer::moveTo (int row, int col) {
+    if (row == this->cursorRow && col == this->cursorCol) {
+        return;
+    }
+    // terminal rows and columns count from 1
+    this->out += "\x1b[";
+    this->out += std::to_string (row + 1);
+    this->out += ';';
+    this->out += std::to_string (col + 1);
+    this->out += 'H';
+    this->cursorRow = row;
+    this->cursorCol = col;
+}
 
-const int RANDOM_MOVE_PERCENTAGE = 15;
+void Renderer::drawFrame (const Gameboard& gb, const std::vector< std::string >& status) {
+    if (gb.rowCount () != this->rows || gb.colCount () != this->cols) {
+        // a cleared screen is all blanks, so blank cells need no drawing
+        this->rows = gb.rowCount ();
+        this->cols = gb.colCount ();
+        this->screen.assign (this->rows * this->cols, ' ');
+        this->screenStatus.clear ();
+        // hide the cursor while drawing
+        this->out += "\x1b[?25l";
+        this->out += CLEAR_SCREEN;
+        this->cursorRow = 0;
+        this->cursorCol = 0;
+    }
 
-// I have plagiarized this hasher from chatgpt
-// Hash function for std::pair<int, int>
-struct pair_hash {
-    template < class T1, class T2 >
-    std::size_t operator() (const std::pair< T1, T2 >& p) const {
-        auto hash1 = std::hash< T1 >{}(p.first);
-        auto hash2 = std::hash< T2 >{}(p.second);
+    for (int i = 0; i < this->rows; i++) {
+        for (int j = 0; j < this->cols; j++) {
+            char cell  = gb.cellAt (i, j);
+            char& seen = this->screen[i * this->cols + j];
+            if (cell == seen) {
+                continue;
+            }
+            this->moveTo (i, j);
+            this->out += cell;
+            seen = cell;
+            this->totals.cellsChanged++;
+            // the cursor is now one right, unless it wrapped at the terminal's edge
+            this->cursorCol = j + 1 < this->cols ? j + 1 : -1;
+        }
+    }
 
-        // Simple hash combining algorithm
-        // You can replace this with a more sophisticated hash function if needed
-        return hash1 ^ hash2;
+    this->screenStatus.resize (std::max (this->screenStatus.size (), status.size ()));
+    for (int i = 0; i < (int)this->screenStatus.size (); i++) {
+        const std::string& line = i < (int)status.size () ? status[i] : std::string ();
+        if (line == this->screenStatus[i]) {
+            continue;
+        }
+        this->moveTo (this->rows + i, 0);
+        // write the line and erase whatever was left of the old one
+        this->out += line;
+        this->out += "\x1b[K";
+        this->screenStatus[i] = line;
+        this->cursorRow       = -1;
     }
-};
 
-// From 5 moves away the ghost will start chasing you!
-const int BFS_DEPTH_GHOST = 5;
+    long bytesBefore    = this->totals.bytes;
+    long syscallsBefore = this->totals.syscalls;
+    this->flush ();
+    this->totals.frames++;
+    this->lastBytes    = this->totals.bytes - bytesBefore;
+    this->lastSyscalls = this->totals.syscalls - syscallsBefore;
+}
 
-std::unique_ptr< Input > Ghost::getNextMove (Gameboard& gb) {
-    // check if Pacman is nearby and if we can move towards the fucker
-    std::pair< int, int > currPos = gb.getCurrPos (this->id);
-    // see if pacman is present anywhere close to us using size limited BFS
-    // hydrate the queue
-    std::unordered_set< std::pair< int, int >, pair_hash > visited;
-    std::queue< BfsNode > q;
-    q.push (BfsNode{ currPos, 0, NOOP });
-    // mark starting point as visited
-    visited.insert (currPos);
-
-    while (!q.empty ()) {
-        BfsNode curr = q.front ();
-        q.pop ();
-
-        // apply the offsets, see which one's are valid, see which one's result in us finding pacman
-        // iterate over enums UP, DOWN, LEFT, RIGHT using their int repr
-        for (int i = 0; i < 4; i++) {
-            std::pair< std::pair< int, int >, Direction > boundaryValidation =
-            gb.validateMoveBoundary (curr.currPos, (Direction)i);
-            if (boundaryValidation.second == NOOP) {
+void Renderer::flush () {
+    const char* data = this->out.data ();
+    size_t left      = this->out.size ();
+    while (left > 0) {
+        ssize_t n = write (this->fd, data, left);
+        this->totals.syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) {
                 continue;
             }
+            // the terminal is gone, nothing useful left to do with the frame
+            break;
+        }
+        data += n;
+        left -= n;
+        this->totals.bytes += n;
+    }
+    this->out.clear ();
+}
 
-            CollisionValidation collValidation =
-            gb.validateCollision (curr.currPos, boundaryValidation.first);
-            // either we cant move or cannot explore further in depth
-            if (collValidation == COLUMNCOL) {
-                continue;
-            }
+RenderStats Renderer::stats () const {
+    return this->totals;
+}
 
-            // init direction is used to keep a track of the very first move we made from pacman for this exploration
-            if (curr.level == 0) {
-                curr.initDirection = (Direction)i;
-            }
+std::string Renderer::lastFrameReadout () const {
+    return "Frame: " + std::to_string (this->lastBytes) + " bytes, " +
+    std::to_string (this->lastSyscalls) + " syscalls";
+}
 
-            if (collValidation == PACMANCOL) {
-				this->lastMove = curr.initDirection;
-                return std::make_unique< Input > (this->id, curr.initDirection);
-            }
+class Ghost {
+    public:
+    Ghost (int id, Seeder& seeder);
+    // only reads the board, so ghosts can plan in parallel
+    Input getNextMove (const Gameboard& gb);
 
-            std::pair< int, int > offset  = boundaryValidation.first;
-            std::pair< int, int > nextPos = { curr.currPos.first + offset.first,
-                curr.currPos.second + offset.second };
-            // only proceed if we haven't visited nextPos before
-            if (visited.find (nextPos) != visited.end () || curr.level == BFS_DEPTH_GHOST) {
-                continue;
-            }
-            q.push (BfsNode{ nextPos, curr.level + 1, curr.initDirection });
-        }
+    private:
+    int id;
+    Direction lastMove;
+    RandGen rg;
+    RandGen randomDirRg;
+};
+
+const Direction dirFrom[4] = { UP, DOWN, LEFT, RIGHT };
+
+Ghost::Ghost (int id, Seeder& seeder)
+: id (id), rg (0, 3, seeder), randomDirRg (1, 100, seeder) {
+    this->lastMove = dirFrom[this->rg.getRandomInt ()];
+}
+
+const int RANDOM_MOVE_PERCENTAGE = 15;
+// failed random tries before a ghost checks whether it can move at all
+const int BOXED_IN_CHECK = 16;
+
+Input Ghost::getNextMove (const Gameboard& gb) {
+    int row = gb.movableY[this->id];
+    int col = gb.movableX[this->id];
+    // if pacman is close the shared distance field knows the way to him
+    Direction chase = gb.field.towardsSource (row, col);
+    if (chase != NOOP) {
+        this->lastMove = chase;
+        return Input (this->id, chase);
     }
 
     // Randome Exploration
-    while (true) {
+    for (int tries = 1;; tries++) {
+        // walls can box a ghost in, then it waits where it is
+        if (tries % BOXED_IN_CHECK == 0 && gb.boxedIn (row, col)) {
+            return Input (this->id, NOOP);
+        }
+
         // Either this is the first move or this is the RANDOM MOVE PERFECNTAGE of the time situation where ghost turns randomly
         Direction moveToMake = this->lastMove;
         if (this->lastMove == NOOP ||
-        this->randomDirRg->getRandomInt () > (100 - RANDOM_MOVE_PERCENTAGE)) {
-            moveToMake = dirFrom[this->rg->getRandomInt ()];
+        this->randomDirRg.getRandomInt () > (100 - RANDOM_MOVE_PERCENTAGE)) {
+            moveToMake = dirFrom[this->rg.getRandomInt ()];
         }
 
         // would making the move be a valid move on the board?
         // if it would not give me a random diff dir
+        int next = gb.validateMoveBoundary (row, col, moveToMake);
+
+        // only walls stop a ghost, and the wall mask answers that
+        // without touching the board
+        if (next >= 0 && !gb.walls.test (next)) {
+            this->lastMove = moveToMake;
+
+            assert (moveToMake != NOOP);
+
+            return Input (this->id, moveToMake);
+        }
 
-        Input ghostInput{ this->id, moveToMake };
+        this->lastMove = dirFrom[this->rg.getRandomInt ()];
+    }
+}
+
+// map command keys to pacman moves in buf, return the number of ghosts wanted or -1 on quit
+int parseCommands (const char* buffer, int len, std::vector< Input >& buf) {
+    int ghostsAdded = 0;
+    for (int i = 0; i < len; i++) {
+        switch (buffer[i]) {
+        case UP_CMD: buf.push_back (Input{ 0, UP }); break;
+        case DOWN_CMD: buf.push_back (Input{ 0, DOWN }); break;
+        case LEFT_CMD: buf.push_back (Input{ 0, LEFT }); break;
+        case RIGHT_CMD: buf.push_back (Input{ 0, RIGHT }); break;
+        case ADD_GHOST: ghostsAdded++; break;
+        case QUIT: return -1;
+        default: break;
+        }
+    }
+    return ghostsAdded;
+}
+
+// read whatever input is waiting on fd into buf, return the number of
+// ghosts wanted or -1 on quit or end of input
+int readInput (int fd, std::vector< Input >& buf) {
+    char buffer[256];
+    ssize_t bytesRead = read (fd, buffer, sizeof (buffer));
+    if (bytesRead < 0) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+    if (bytesRead == 0) {
+        return -1;
+    }
+    return parseCommands (buffer, bytesRead, buf);
+}
+
+// Runs a job over a range of indices on a few worker threads and the
+// calling thread, handing out fixed size chunks from an atomic counter.
+// With one thread it just runs the job inline.
+class PlannerPool {
+    public:
+    // threads counts the calling thread, 0 means one per core
+    explicit PlannerPool (int threads);
+    ~PlannerPool ();
+
+    PlannerPool (const PlannerPool&)            = delete;
+    PlannerPool& operator= (const PlannerPool&) = delete;
+
+    // call job (begin, end) over [0, count) and return when all of it is done
+    void run (int count, const std::function< void (int, int) >& job);
+    int threadCount () const;
+
+    private:
+    std::vector< std::thread > workers;
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    // the job being run, set under lock
+    const std::function< void (int, int) >* job;
+    int jobCount;
+    long generation;
+    // workers not finished with the current generation
+    int busy;
+    bool stopping;
+    std::atomic< int > nextIndex;
+
+    void workerLoop ();
+    void work ();
+};
+
+// ghosts a thread takes at a time, enough to keep the counter cold
+const int PLAN_CHUNK = 256;
+
+PlannerPool::PlannerPool (int threads)
+: job (nullptr), jobCount (0), generation (0), busy (0), stopping (false), nextIndex (0) {
+    if (threads <= 0) {
+        threads = std::max (1u, std::thread::hardware_concurrency ());
+    }
+    for (int i = 1; i < threads; i++) {
+        this->workers.emplace_back (&PlannerPool::workerLoop, this);
+    }
+}
 
-        std::pair< std::pair< int, int >, Direction > res =
-        gb.validateMoveBoundary (currPos, moveToMake);
+PlannerPool::~PlannerPool () {
+    {
+        std::lock_guard< std::mutex > guard (this->lock);
+        this->stopping = true;
+    }
+    this->start.notify_all ();
+    for (std::thread& worker : this->workers) {
+        worker.join ();
+    }
+}
 
-        if (res.second != NOOP) {
-            // collision based checking for columns if the move
-            // doesn't lead us into the column we are okay to proceed
-            CollisionValidation collValidation =
-            gb.validateCollision (currPos, res.first);
-            if (collValidation != COLUMNCOL) {
-                this->lastMove = moveToMake;
+int PlannerPool::threadCount () const {
+    return this->workers.size () + 1;
+}
+
+void PlannerPool::run (int count, const std::function< void (int, int) >& job) {
+    if (this->workers.empty () || count <= PLAN_CHUNK) {
+        job (0, count);
+        return;
+    }
+    {
+        std::lock_guard< std::mutex > guard (this->lock);
+        this->job      = &job;
+        this->jobCount = count;
+        this->nextIndex.store (0);
+        this->busy = this->workers.size ();
+        this->generation++;
+    }
+    this->start.notify_all ();
+    this->work ();
+
+    std::unique_lock< std::mutex > guard (this->lock);
+    this->done.wait (guard, [this] () { return this->busy == 0; });
+    this->job = nullptr;
+}
 
-                assert (moveToMake != NOOP);
+void PlannerPool::work () {
+    while (true) {
+        int begin = this->nextIndex.fetch_add (PLAN_CHUNK);
+        if (begin >= this->jobCount) {
+            return;
+        }
+        (*this->job) (begin, std::min (begin + PLAN_CHUNK, this->jobCount));
+    }
+}
 
-                return std::make_unique< Input > (std::move (ghostInput));
+void PlannerPool::workerLoop () {
+    long seen = 0;
+    while (true) {
+        {
+            std::unique_lock< std::mutex > guard (this->lock);
+            this->start.wait (guard, [&] () { return this->stopping || this->generation != seen; });
+            if (this->stopping) {
+                return;
             }
+            seen = this->generation;
+        }
+        this->work ();
+        {
+            std::lock_guard< std::mutex > guard (this->lock);
+            this->busy--;
         }
+        this->done.notify_one ();
+    }
+}
 
-        this->lastMove = dirFrom[this->rg->getRandomInt ()];
-    }
-}
-
-// get updates from user using eventloop style IO multiplexing, return the number of ghosts wanted to be updated
-int handleFakeInterrupt (struct pollfd fds[], std::vector< std::unique_ptr< Input > >& buf) {
-    // "1" specifies size of fds
-    int result = poll (fds, 1, NON_BLOCKING_EVENT_LOOP_INPUT_POLL);
-    // some FD has an event for us
-    if (result > 0) {
-        // based on which FD it is, we map to the player and move the player
-        if (fds[0].revents & POLLIN) {
-            char buffer[256];
-            ssize_t bytesRead = read (STDIN_FILENO, buffer, sizeof (buffer));
-
-            if (bytesRead > 0) {
-                int ghostsAdded = 0;
-                for (int i = 0; i < bytesRead; i++) {
-                    std::unique_ptr< Input > userInput = nullptr;
-                    switch (buffer[i]) {
-                    case UP_CMD:
-                        userInput = std::make_unique< Input > (Input{ 0, UP });
-                        break;
-                    case DOWN_CMD:
-                        userInput = std::make_unique< Input > (Input{ 0, DOWN });
-                        break;
-                    case LEFT_CMD:
-                        userInput = std::make_unique< Input > (Input{ 0, LEFT });
-                        break;
-                    case RIGHT_CMD:
-                        userInput = std::make_unique< Input > (Input{ 0, RIGHT });
-                        break;
-                    case ADD_GHOST: ghostsAdded++; break;
-                    case QUIT: return -1;
-                    default: break;
-                    }
-                    if (userInput != nullptr) {
-                        buf.push_back (std::move (userInput));
-                    }
-                }
-                return ghostsAdded;
+// The simulation without any terminal IO. The interactive and the
+// headless loop both drive it one tick at a time.
+class Game {
+    public:
+    Game (int rows, int cols, int wallPercentage, int numGhosts, int chaseRadius,
+    int planThreads, ScoreKeeper& score, Seeder& seeder);
+    // ghosts plan, then they and the user input move, then ghostsAdded ghosts spawn
+    void tick (std::vector< Input >& userInput, int ghostsAdded);
+    Gameboard& board ();
+    int planThreads () const;
+
+    private:
+    ScoreKeeper& score;
+    Seeder& seeder;
+    Gameboard gb;
+    std::vector< Ghost > ghosts;
+    // use the same vector to fill and drain
+    std::vector< Input > gameplayInstructionBuffer;
+    bool moveGhost;
+    PlannerPool planners;
+
+    void addGhost ();
+};
+
+Game::Game (int rows, int cols, int wallPercentage, int numGhosts, int chaseRadius,
+int planThreads, ScoreKeeper& score, Seeder& seeder)
+: score (score), seeder (seeder), gb (rows, cols, score, seeder, chaseRadius), moveGhost (true),
+  planners (planThreads) {
+    // add base player
+    this->gb.insertMovable ();
+    this->gb.drawWalls (wallPercentage);
+
+    for (int i = 0; i < numGhosts; i++) {
+        this->addGhost ();
+    }
+}
+
+void Game::addGhost () {
+    this->ghosts.push_back (Ghost (this->gb.insertMovable (), this->seeder));
+    this->score.notify (GHOSTADDED);
+}
+
+void Game::tick (std::vector< Input >& userInput, int ghostsAdded) {
+    // shitty hack to slow the ghosts down?
+    if (this->moveGhost) {
+        this->gb.refreshField ();
+        // Every ghost reads the same board and writes only its own RNG and
+        // its own slot, so the moves come out the same on any number of
+        // threads. They are committed in ghost order below.
+        this->gameplayInstructionBuffer.resize (this->ghosts.size ());
+        const Gameboard& board = this->gb;
+        this->planners.run (this->ghosts.size (), [&] (int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                this->gameplayInstructionBuffer[i] = this->ghosts[i].getNextMove (board);
             }
+        });
+    }
+    this->moveGhost = !this->moveGhost;
+
+    for (const Input& input : userInput) {
+        this->gameplayInstructionBuffer.push_back (input);
+    }
+    userInput.clear ();
+
+    this->gb.update (this->gameplayInstructionBuffer);
+
+    this->gameplayInstructionBuffer.clear ();
+
+    for (int i = 0; i < ghostsAdded; i++) {
+        this->addGhost ();
+    }
+}
+
+Gameboard& Game::board () {
+    return this->gb;
+}
+
+int Game::planThreads () const {
+    return this->planners.threadCount ();
+}
+
+// Counts durations in microseconds, 10 us buckets up to 10 ms and 1 ms
+// buckets up to a second, anything longer in the last one. The buckets
+// are allocated up front, so recording from the game loop never
+// allocates.
+class TimingHistogram {
+    public:
+    TimingHistogram ();
+    void record (long micros);
+    long count () const;
+    // upper bound of the bucket holding the p-th fraction of the samples
+    long percentile (double p) const;
+    long max () const;
+
+    private:
+    std::vector< long > buckets;
+    long samples;
+    long maxSeen;
+
+    static int bucketOf (long micros);
+    static long bucketBound (int bucket);
+};
+
+const int FINE_BUCKETS   = 1000;
+const int COARSE_BUCKETS = 990;
+
+TimingHistogram::TimingHistogram ()
+: buckets (FINE_BUCKETS + COARSE_BUCKETS + 1, 0), samples (0), maxSeen (0) {
+}
+
+int TimingHistogram::bucketOf (long micros) {
+    if (micros < 10 * FINE_BUCKETS) {
+        return micros < 0 ? 0 : micros / 10;
+    }
+    return std::min< long > (FINE_BUCKETS + (micros - 10 * FINE_BUCKETS) / 1000,
+    FINE_BUCKETS + COARSE_BUCKETS);
+}
+
+long TimingHistogram::bucketBound (int bucket) {
+    if (bucket < FINE_BUCKETS) {
+        return 10L * (bucket + 1);
+    }
+    return 10L * FINE_BUCKETS + 1000L * (bucket - FINE_BUCKETS + 1);
+}
+
+void TimingHistogram::record (long micros) {
+    this->buckets[bucketOf (micros)]++;
+    this->samples++;
+    this->maxSeen = std::max (this->maxSeen, micros);
+}
+
+long TimingHistogram::count () const {
+    return this->samples;
+}
+
+long TimingHistogram::percentile (double p) const {
+    long wanted = (long)(p * this->samples + 0.5);
+    long seen   = 0;
+    for (int i = 0; i < (int)this->buckets.size (); i++) {
+        seen += this->buckets[i];
+        if (seen >= wanted && seen > 0) {
+            // the last bucket has no bound of its own
+            return i + 1 < (int)this->buckets.size () ? std::min (bucketBound (i), this->maxSeen) : this->maxSeen;
         }
     }
+    return this->maxSeen;
+}
 
-    return 0;
+long TimingHistogram::max () const {
+    return this->maxSeen;
+}
+
+void reportTiming (std::ostream& os, const char* name, const TimingHistogram& hist) {
+    if (hist.count () == 0) {
+        return;
+    }
+    os << name << " us: p50 " << hist.percentile (0.5) << ", p90 " << hist.percentile (0.9)
+       << ", p99 " << hist.percentile (0.99) << ", max " << hist.max () << " ("
+       << hist.count () << " samples)\n";
 }
 
 // RAII wrapper to restore state of terminal
@@ -544,6 +1156,41 @@ class TerminalInputConfigManager {
     std::unique_ptr< struct termios > originalTerminalAttr;
 };
 
+// Owns a file descriptor and closes it when it goes out of scope, so the
+// early returns while setting up the game loop do not leak it.
+class FileDescriptor {
+    public:
+    explicit FileDescriptor (int fd) : fd (fd) {
+    }
+
+    FileDescriptor (const FileDescriptor&)            = delete;
+    FileDescriptor& operator= (const FileDescriptor&) = delete;
+
+    ~FileDescriptor () {
+        if (this->fd >= 0) {
+            close (this->fd);
+        }
+    }
+
+    int get () const {
+        return this->fd;
+    }
+
+    bool isOpen () const {
+        return this->fd >= 0;
+    }
+
+    private:
+    int fd;
+};
+
+// report which call failed and why, for the setup of the game loop
+int setupFailed (const char* call) {
+    const char* reason = std::strerror (errno);
+    std::cerr << "pacman: " << call << ": " << reason << std::endl;
+    return -1;
+}
+
 void displayInstructions () {
     std::cout << "---- Game Instructions ---- \n"
               << "spacebar -> add a ghost \n"
@@ -556,7 +1203,179 @@ void displayInstructions () {
     std::cin.ignore (std::numeric_limits< std::streamsize >::max (), '\n');
 }
 
-int main () {
+struct Options {
+    bool headless      = false;
+    long ticks         = 100000;
+    bool seeded        = false;
+    std::uint64_t seed = 0;
+    int rows           = 20;
+    int cols           = 40;
+    int ghosts         = 1;
+    int walls          = 5;
+    int chase          = BFS_DEPTH_GHOST;
+    // threads planning ghost moves, 0 for one per core
+    int threads = 0;
+    // headless only, draw every frame to stdout anyway
+    bool render = false;
+    // when the timer wakes late, run the missed ticks or skip them
+    bool dropLateTicks = false;
+    // headless input, one command key per tick, repeated
+    std::string script;
+};
+
+void displayUsage (const char* prog) {
+    std::cerr << "usage: " << prog << " [options]\n"
+              << "  --headless      run without a terminal as fast as possible\n"
+              << "  --ticks N       headless ticks to run (100000)\n"
+              << "  --seed S        seed every random generator from S\n"
+              << "  --rows R        board rows (20)\n"
+              << "  --cols C        board columns (40)\n"
+              << "  --ghosts G      ghosts at the start (1)\n"
+              << "  --walls P       percentage of cells that are walls (5)\n"
+              << "  --chase D       ghosts chase pacman from D + 1 moves away, 0 for anywhere (5)\n"
+              << "  --threads T     threads planning ghost moves, 0 for one per core (0)\n"
+              << "  --script KEYS   headless input, one key per tick, repeated\n"
+              << "  --render        headless, draw every frame to stdout anyway\n"
+              << "  --late P        missed ticks after a late wake: catchup (up to "
+              << MAX_CATCH_UP_TICKS << ") or drop (catchup)\n";
+}
+
+// false on anything it does not understand
+bool parseOptions (int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            opts.headless = true;
+            continue;
+        }
+        if (arg == "--render") {
+            opts.render = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--ticks") {
+            opts.ticks = std::strtol (value, nullptr, 10);
+        } else if (arg == "--seed") {
+            opts.seeded = true;
+            opts.seed   = std::strtoull (value, nullptr, 10);
+        } else if (arg == "--rows") {
+            opts.rows = std::atoi (value);
+        } else if (arg == "--cols") {
+            opts.cols = std::atoi (value);
+        } else if (arg == "--ghosts") {
+            opts.ghosts = std::atoi (value);
+        } else if (arg == "--walls") {
+            opts.walls = std::atoi (value);
+        } else if (arg == "--chase") {
+            opts.chase = std::atoi (value);
+        } else if (arg == "--threads") {
+            opts.threads = std::atoi (value);
+        } else if (arg == "--late") {
+            std::string policy = value;
+            if (policy != "catchup" && policy != "drop") {
+                return false;
+            }
+            opts.dropLateTicks = policy == "drop";
+        } else if (arg == "--script") {
+            opts.script = value;
+        } else {
+            return false;
+        }
+    }
+    return opts.rows > 1 && opts.cols > 1 && opts.ghosts >= 0 && opts.ticks >= 0 && opts.chase >= 0 &&
+    opts.threads >= 0;
+}
+
+void reportRenderStats (std::ostream& os, const RenderStats& stats) {
+    if (stats.frames == 0) {
+        return;
+    }
+    os << "frames: " << stats.frames << "\n"
+       << "bytes/frame: " << (double)stats.bytes / stats.frames << "\n"
+       << "syscalls/frame: " << (double)stats.syscalls / stats.frames << "\n"
+       << "cells changed/frame: " << (double)stats.cellsChanged / stats.frames << "\n";
+}
+
+// Run the game with scripted input, by default without rendering, then
+// report the rate on stderr
+int runHeadless (const Options& opts, Seeder& seeder) {
+    ScoreKeeper score;
+    Game game (opts.rows, opts.cols, opts.walls, opts.ghosts, opts.chase, opts.threads, score, seeder);
+    std::vector< Input > userInput;
+    std::unique_ptr< Renderer > renderer;
+    std::vector< std::string > status;
+    if (opts.render) {
+        renderer = std::make_unique< Renderer > (STDOUT_FILENO);
+    }
+
+    // allocations in ticks that spawned no ghost, spawning grows vectors
+    long steadyTicks       = 0;
+    long steadyAllocations = 0;
+    auto start             = std::chrono::steady_clock::now ();
+    long tick              = 0;
+    for (; tick < opts.ticks; tick++) {
+        int ghostsAdded = 0;
+        if (!opts.script.empty ()) {
+            ghostsAdded =
+            parseCommands (&opts.script[tick % opts.script.size ()], 1, userInput);
+            if (ghostsAdded < 0) {
+                break;
+            }
+        }
+        long allocationsBefore = heapAllocations.load (std::memory_order_relaxed);
+        game.tick (userInput, ghostsAdded);
+        if (ghostsAdded == 0) {
+            steadyTicks++;
+            steadyAllocations += heapAllocations.load (std::memory_order_relaxed) - allocationsBefore;
+        }
+        if (renderer != nullptr) {
+            status.clear ();
+            score.displayScore (status);
+            status.push_back (renderer->lastFrameReadout ());
+            renderer->drawFrame (game.board (), status);
+        }
+    }
+    std::chrono::duration< double > elapsed = std::chrono::steady_clock::now () - start;
+    RenderStats renderStats = renderer != nullptr ? renderer->stats () : RenderStats{ 0, 0, 0, 0 };
+    // restore the cursor before the report
+    renderer.reset ();
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    // the ghost, its position and facing, and its slot in the move buffer
+    size_t bytesPerGhost = sizeof (Ghost) + 2 * sizeof (int) + sizeof (Direction) + sizeof (Input);
+
+    std::cerr << "ticks: " << tick << "\n"
+              << "seconds: " << elapsed.count () << "\n"
+              << "ticks/sec: " << tick / elapsed.count () << "\n"
+              << "board: " << opts.rows << "x" << opts.cols << "\n"
+              << "ghosts: " << score.ghosts () << "\n"
+              << "plan threads: " << game.planThreads () << "\n"
+              << "times caught: " << score.caught () << "\n"
+              << "distance field rebuilds: " << game.board ().fieldRebuilds () << "\n"
+              << "heap allocations/tick: "
+              << (steadyTicks > 0 ? (double)steadyAllocations / steadyTicks : 0.0) << "\n"
+              << "bytes per ghost: " << bytesPerGhost << "\n"
+              << "peak rss KB: " << usage.ru_maxrss << "\n"
+              << "checksum: " << std::hex << game.board ().checksum () << std::dec << "\n";
+    reportRenderStats (std::cerr, renderStats);
+    return 0;
+}
+
+long microsSince (const struct timespec& from, const struct timespec& to) {
+    return (to.tv_sec - from.tv_sec) * 1000000L + (to.tv_nsec - from.tv_nsec) / 1000;
+}
+
+// The game on the terminal. A periodic timerfd drives the simulation at
+// a fixed step of FRAME, and stdin is read the moment epoll reports it,
+// so a key waits only for the next tick, not for a sleep to run out.
+// When the loop wakes late, the missed ticks are either run back to
+// back, up to MAX_CATCH_UP_TICKS, or dropped. Then one frame is drawn.
+// On exit it reports how late the timer wakes were, and how long a key
+// took to reach the screen.
+int runInteractive (const Options& opts, Seeder& seeder) {
     displayInstructions ();
 
     TerminalInputConfigManager cm;
@@ -564,72 +1383,146 @@ int main () {
         return -1;
     }
 
-    // monitor FD's for user using IO multiplexing
-    struct pollfd fds[1];
-    fds[0].fd = STDIN_FILENO;
-    // monitor FD for standard in
-    fds[0].events = POLLIN;
-
-    // use the same vector to fill and drain
-    std::vector< std::unique_ptr< Input > > gameplayInstructionBuffer;
+    FileDescriptor timer (timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (!timer.isOpen ()) {
+        return setupFailed ("timerfd_create");
+    }
+    FileDescriptor ep (epoll_create1 (EPOLL_CLOEXEC));
+    if (!ep.isOpen ()) {
+        return setupFailed ("epoll_create1");
+    }
+    struct epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = STDIN_FILENO;
+    if (epoll_ctl (ep.get (), EPOLL_CTL_ADD, STDIN_FILENO, &ev) < 0) {
+        return setupFailed ("epoll_ctl stdin");
+    }
+    ev.data.fd = timer.get ();
+    if (epoll_ctl (ep.get (), EPOLL_CTL_ADD, timer.get (), &ev) < 0) {
+        return setupFailed ("epoll_ctl timer");
+    }
 
-    // setup gameboard
-    int rows = 20;
-    int cols = 40;
+    std::vector< Input > userInput;
 
     // because score lives for the lifetime	of the program we can keep it on the stack
     ScoreKeeper score;
 
-    Gameboard gb (rows, cols, score);
+    Game game (opts.rows, opts.cols, opts.walls, opts.ghosts, opts.chase, opts.threads, score, seeder);
 
-    // add base player
-    gb.insertMovable ();
-    gb.drawWalls (5);
+    runCountdown (3);
 
-    // Make this a vector so we can add ghosts at runtime?
-    std::vector< Ghost > ghosts;
-    ghosts.push_back (Ghost (gb.insertMovable ()));
-    score.notify (GHOSTADDED);
+    std::vector< std::string > status;
+    auto renderer = std::make_unique< Renderer > (STDOUT_FILENO);
+
+    // tick k is due at start + k * FRAME, absolute so that late wakes do not drift
+    struct timespec start;
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    struct itimerspec period;
+    period.it_interval.tv_sec  = FRAME / SECOND;
+    period.it_interval.tv_nsec = (FRAME % SECOND) * 1000L;
+    period.it_value.tv_sec     = start.tv_sec + period.it_interval.tv_sec;
+    period.it_value.tv_nsec    = start.tv_nsec + period.it_interval.tv_nsec;
+    if (period.it_value.tv_nsec >= 1000000000L) {
+        period.it_value.tv_sec++;
+        period.it_value.tv_nsec -= 1000000000L;
+    }
+    if (timerfd_settime (timer.get (), TFD_TIMER_ABSTIME, &period, nullptr) < 0) {
+        return setupFailed ("timerfd_settime");
+    }
 
-    runCountdown (3);
+    TimingHistogram jitter;
+    TimingHistogram inputLatency;
+    // when the oldest key not yet on screen arrived, tv_sec -1 for none
+    struct timespec pendingSince = { -1, 0 };
+    long ticksDue     = 0;
+    long ticksRun     = 0;
+    long ticksDropped = 0;
+    int ghostsAdded   = 0;
+    bool quit         = false;
 
-    bool moveGhost = true;
     // main Gameloop
-    while (true) {
-        // shitty hack to slow the ghosts down?
-        if (moveGhost) {
-            for (int i = 0; i < (int)ghosts.size (); i++) {
-                gameplayInstructionBuffer.push_back (ghosts[i].getNextMove (gb));
+    while (!quit) {
+        struct epoll_event events[2];
+        int ready = epoll_wait (ep.get (), events, 2, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-        }
-        moveGhost = !moveGhost;
-
-        int ghostsAdded = handleFakeInterrupt (fds, gameplayInstructionBuffer);
-        // less than 0 means quit was pressed
-        if (ghostsAdded < 0) {
-            // user wanted to exit the game
             break;
         }
 
-        gb.draw (gameplayInstructionBuffer);
-
-        gameplayInstructionBuffer.clear ();
-
-        score.displayScore ();
+        for (int i = 0; i < ready && !quit; i++) {
+            struct timespec now;
+            clock_gettime (CLOCK_MONOTONIC, &now);
+
+            if (events[i].data.fd == STDIN_FILENO) {
+                int added = readInput (STDIN_FILENO, userInput);
+                // less than 0 means quit was pressed
+                if (added < 0) {
+                    // user wanted to exit the game
+                    quit = true;
+                    break;
+                }
+                ghostsAdded += added;
+                if (pendingSince.tv_sec < 0) {
+                    pendingSince = now;
+                }
+                continue;
+            }
 
-        for (int i = 0; i < ghostsAdded; i++) {
-            ghosts.push_back (Ghost (gb.insertMovable ()));
-            score.notify (GHOSTADDED);
+            std::uint64_t expirations = 0;
+            if (read (timer.get (), &expirations, sizeof (expirations)) != sizeof (expirations)) {
+                continue;
+            }
+            ticksDue += expirations;
+            // how long after the latest due tick we got to run it
+            jitter.record (microsSince (start, now) - ticksDue * (long)FRAME);
+
+            long ticks = opts.dropLateTicks ? 1 : std::min< long > (expirations, MAX_CATCH_UP_TICKS);
+            ticksDropped += expirations - ticks;
+            for (long t = 0; t < ticks; t++) {
+                game.tick (userInput, ghostsAdded);
+                ghostsAdded = 0;
+            }
+            ticksRun += ticks;
+
+            status.clear ();
+            score.displayScore (status);
+            status.push_back (renderer->lastFrameReadout ());
+            renderer->drawFrame (game.board (), status);
+
+            if (pendingSince.tv_sec >= 0) {
+                struct timespec drawn;
+                clock_gettime (CLOCK_MONOTONIC, &drawn);
+                inputLatency.record (microsSince (pendingSince, drawn));
+                pendingSince.tv_sec = -1;
+            }
         }
-
-        usleep (FRAME);
-
-        // clear screen	by handing command to shell
-        system ("clear");
     }
-
+    RenderStats renderStats = renderer->stats ();
+    // restore the cursor before printing anything else
+    renderer.reset ();
+
+    reportRenderStats (std::cout, renderStats);
+    std::cout << "ticks: " << ticksRun << ", dropped: " << ticksDropped << "\n";
+    reportTiming (std::cout, "timer jitter", jitter);
+    reportTiming (std::cout, "input to display", inputLatency);
     std::cout << "Thanks for playing!" << std::endl;
     std::cout << "~ Hamdaan Khalid" << std::endl;
 
     return 0;
 }
+
+int main (int argc, char** argv) {
+    Options opts;
+    if (!parseOptions (argc, argv, opts)) {
+        displayUsage (argv[0]);
+        return 2;
+    }
+    Seeder seeder = opts.seeded ? Seeder (opts.seed) : Seeder ();
+
+    if (opts.headless) {
+        return runHeadless (opts, seeder);
+    }
+    return runInteractive (opts, seeder);
+}
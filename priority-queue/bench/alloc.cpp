@@ -0,0 +1,170 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <thread>
+#include <harness.hh>
+#include <pq.hh>
+#include <pq_alloc.hh>
+
+/*
+ * Short lived queue churn, the one queue per request pattern. Every
+ * thread runs requests back to back, each building a Pq of m jobs and
+ * draining it, with the queue storage coming from:
+ *
+ *   std::allocator          the global heap, vectors grow by doubling
+ *   std::allocator+reserve  the global heap, one allocation per vector
+ *   arena                   a per thread ArenaResource reset per request
+ *   pool+reserve            a per thread PoolResource of fixed blocks
+ *   pmr unsynchronized_pool the standard library pool, for reference
+ *
+ * Global operator new is replaced in this binary to count calls, so each
+ * row is followed by a note with global allocations per request.
+ * Usage: bench_alloc [maxThreads] [requestsPerThread] [m]
+ */
+
+static std::atomic<std::size_t> globalNews{0};
+
+void* operator new(std::size_t size) {
+	globalNews.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+struct Job {
+	std::uint32_t id;
+	std::uint32_t weight;
+	std::uint64_t deadline;
+};
+
+template<typename Q>
+long long fillAndDrain(Q& q, const std::vector<int>& keys, std::size_t offset, std::size_t m) {
+	for (std::size_t i = 0; i < m; i++) {
+		int k = keys[(offset + i) % keys.size()];
+		q.emplace(k, Job{static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(k), 0});
+	}
+	long long sum = 0;
+	while (!q.isEmpty()) {
+		sum += q.dequeue().weight;
+	}
+	return sum;
+}
+
+enum class Mode {
+	GLOBAL,
+	GLOBAL_RESERVE,
+	ARENA,
+	POOL,
+	STD_POOL,
+};
+
+const char* modeName(Mode mode) {
+	switch (mode) {
+	case Mode::GLOBAL: return "std::allocator";
+	case Mode::GLOBAL_RESERVE: return "std::allocator+reserve";
+	case Mode::ARENA: return "arena";
+	case Mode::POOL: return "pool+reserve";
+	default: return "pmr unsynchronized_pool";
+	}
+}
+
+void worker(Mode mode, std::size_t t, std::size_t requests, std::size_t m,
+	const std::vector<int>& keys) {
+	long long sum = 0;
+	// sized to the request up front, the arena would also learn it after one reset
+	ArenaResource arena(2 * m * (sizeof(int) + sizeof(Job)));
+	PoolResource pool(m * sizeof(Job), 4);
+	std::pmr::unsynchronized_pool_resource stdPool;
+
+	for (std::size_t r = 0; r < requests; r++) {
+		std::size_t offset = (t * requests + r) * 31;
+		switch (mode) {
+		case Mode::GLOBAL: {
+			Pq<Job, 4> q;
+			sum += fillAndDrain(q, keys, offset, m);
+			break;
+		}
+		case Mode::GLOBAL_RESERVE: {
+			Pq<Job, 4> q;
+			q.reserve(m);
+			sum += fillAndDrain(q, keys, offset, m);
+			break;
+		}
+		case Mode::ARENA: {
+			{
+				PmrPq<Job, 4> q(&arena);
+				sum += fillAndDrain(q, keys, offset, m);
+			}
+			arena.reset();
+			break;
+		}
+		case Mode::POOL: {
+			PmrPq<Job, 4> q(&pool);
+			q.reserve(m);
+			sum += fillAndDrain(q, keys, offset, m);
+			break;
+		}
+		default: {
+			PmrPq<Job, 4> q(&stdPool);
+			sum += fillAndDrain(q, keys, offset, m);
+			break;
+		}
+		}
+	}
+	bench::doNotOptimize(sum);
+}
+
+void churn(Mode mode, std::size_t threads, std::size_t requests, std::size_t m,
+	const std::vector<int>& keys) {
+	std::size_t before = globalNews.load();
+	auto start = bench::Clock::now();
+	std::vector<std::thread> workers;
+	for (std::size_t t = 0; t < threads; t++) {
+		workers.emplace_back(worker, mode, t, requests, m, std::cref(keys));
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+	double ns = bench::nsSince(start);
+	std::size_t news = globalNews.load() - before;
+
+	std::string label = std::string("churn/") + modeName(mode) + "/threads=" + std::to_string(threads);
+	bench::report(label, m, threads * requests, ns);
+	bench::note("  %-40s %.3f global allocations per request\n", label.c_str(),
+		static_cast<double>(news) / (threads * requests));
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxThreads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+	std::size_t requests = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+	std::size_t m = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 256;
+	maxThreads = maxThreads < 1 ? 1 : maxThreads;
+
+	std::vector<int> keys = bench::randomKeys(1 << 16, 41);
+	const Mode modes[] = {
+		Mode::GLOBAL,
+		Mode::GLOBAL_RESERVE,
+		Mode::ARENA,
+		Mode::POOL,
+		Mode::STD_POOL,
+	};
+	for (std::size_t t = 1; t <= maxThreads; t *= 2) {
+		for (Mode mode : modes) {
+			churn(mode, t, requests, m, keys);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include <cstdlib>
+#include <string>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * Hold model throughput for binary, 4-ary and 8-ary heaps. The heap is
+ * filled to n then every op is one dequeue followed by one enqueue so the
+ * size stays put. Sizes go from L1 resident up to far beyond the LLC.
+ */
+
+template<std::size_t Arity>
+void run(std::size_t n, const std::vector<int>& keys, std::size_t ops) {
+	Pq<int, Arity> q;
+	for (std::size_t i = 0; i < n; i++) {
+		q.enqueue(keys[i], keys[i]);
+	}
+
+	long long sum = 0;
+	std::size_t next = n;
+	auto start = bench::Clock::now();
+	for (std::size_t i = 0; i < ops; i++) {
+		int top = q.dequeue();
+		sum += top;
+		// keep the new key below the popped one so the hold model is stable
+		int key = top - (keys[next] & 0xffff);
+		q.enqueue(key, key);
+		next = next + 1 == keys.size() ? 0 : next + 1;
+	}
+	double ns = bench::nsSince(start);
+	bench::doNotOptimize(sum);
+
+	std::string name = "hold arity=" + std::to_string(Arity);
+	bench::report(name.c_str(), n, ops, ns);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 25);
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+	for (std::size_t n = 1u << 10; n <= maxN; n <<= 3) {
+		std::vector<int> keys = bench::randomKeys(n + ops, 7);
+		run<2>(n, keys, ops);
+		run<4>(n, keys, ops);
+		run<8>(n, keys, ops);
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <string>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * Implicit versus blocked heap layouts on heaps far larger than the LLC.
+ * Each queue is filled with n random keys, then runs a hold model
+ * (dequeue then enqueue at a fixed size) and finally dequeues ops keys.
+ * Next to the time, data TLB and LLC read misses per operation are noted
+ * when perf counters can be opened.
+ * Usage: bench_blocked [maxN] [ops]
+ */
+
+template<typename Q>
+void run(const std::string& name, const std::vector<int>& keys, std::size_t n, std::size_t ops) {
+	bench::PerfCounters perf;
+	Q q;
+	q.reserve(n);
+
+	auto phase = [&](const char* what, std::size_t count, auto&& body) {
+		perf.start();
+		auto start = bench::Clock::now();
+		body();
+		double ns = bench::nsSince(start);
+		perf.stop();
+		std::string label = name + " " + what;
+		bench::report(label, n, count, ns);
+		if (perf.available(bench::PerfCounters::DTLB_MISSES)) {
+			bench::note("  %s: %.3f dTLB misses/op, %.3f LLC misses/op\n", label.c_str(),
+				static_cast<double>(perf.read(bench::PerfCounters::DTLB_MISSES)) / count,
+				static_cast<double>(perf.read(bench::PerfCounters::LLC_MISSES)) / count);
+		}
+	};
+
+	long long sum = 0;
+	phase("fill", n, [&]() {
+		for (std::size_t i = 0; i < n; i++) {
+			q.enqueue(i, keys[i]);
+		}
+	});
+	phase("hold", ops, [&]() {
+		for (std::size_t i = 0; i < ops; i++) {
+			sum += q.dequeue();
+			q.enqueue(i, keys[n + i]);
+		}
+	});
+	phase("dequeue", ops, [&]() {
+		for (std::size_t i = 0; i < ops; i++) {
+			sum += q.dequeue();
+		}
+	});
+	bench::doNotOptimize(sum);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+	{
+		bench::PerfCounters perf;
+		if (!perf.available(bench::PerfCounters::DTLB_MISSES)) {
+			bench::note("perf counters unavailable, reporting time only\n");
+		}
+	}
+
+	for (std::size_t n = 1000000; n <= maxN; n *= 10) {
+		std::size_t hold = ops < n ? ops : n;
+		std::vector<int> keys = bench::randomKeys(n + hold, 97);
+		run<Pq<int, 2> >("Pq<2>", keys, n, hold);
+		run<BlockedPq<int, 2, int, std::greater<int>, 3> >("Pq<2> blocked 56B", keys, n, hold);
+		run<BlockedPq<int, 2, int, std::greater<int>, 4> >("Pq<2> blocked 120B", keys, n, hold);
+		run<BlockedPq<int, 2> >("Pq<2> blocked 4088B", keys, n, hold);
+		run<Pq<int, 4> >("Pq<4>", keys, n, hold);
+		run<BlockedPq<int, 4, int, std::greater<int>, 2> >("Pq<4> blocked 80B", keys, n, hold);
+		run<BlockedPq<int, 4, int, std::greater<int>, 4> >("Pq<4> blocked 1360B", keys, n, hold);
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <utility>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * One enqueue per item versus the bulk paths: building from a range,
+ * appending batches of 1000 into a live heap, and popping top-k in one
+ * dequeueBatch call versus k dequeue calls.
+ */
+
+const std::size_t BATCH = 1000;
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+	for (std::size_t n = 10000; n <= maxN; n *= 10) {
+		std::vector<int> keys = bench::randomKeys(n, 11);
+		std::vector<std::pair<int, int> > entries;
+		entries.reserve(n);
+		for (int k : keys) {
+			entries.emplace_back(k, k);
+		}
+
+		{
+			Pq<int> q;
+			auto start = bench::Clock::now();
+			for (int k : keys) {
+				q.enqueue(k, k);
+			}
+			bench::report("enqueue one by one", n, n, bench::nsSince(start));
+		}
+
+		{
+			auto start = bench::Clock::now();
+			Pq<int> q(entries.begin(), entries.end());
+			bench::report("range constructor", n, n, bench::nsSince(start));
+			bench::doNotOptimize(q.peek());
+		}
+
+		{
+			Pq<int> q;
+			auto start = bench::Clock::now();
+			for (std::size_t i = 0; i < n; i += BATCH) {
+				std::size_t end = i + BATCH < n ? i + BATCH : n;
+				q.enqueueBulk(entries.begin() + i, entries.begin() + end);
+			}
+			bench::report("enqueueBulk batches of 1000", n, n, bench::nsSince(start));
+		}
+
+		std::size_t k = n / 10;
+		std::vector<int> out(k);
+		{
+			Pq<int> q(entries.begin(), entries.end());
+			auto start = bench::Clock::now();
+			for (std::size_t i = 0; i < k; i++) {
+				out[i] = q.dequeue();
+			}
+			bench::report("top 10% via dequeue", n, k, bench::nsSince(start));
+		}
+
+		{
+			Pq<int> q(entries.begin(), entries.end());
+			auto start = bench::Clock::now();
+			q.dequeueBatch(k, out.begin());
+			bench::report("top 10% via dequeueBatch", n, k, bench::nsSince(start));
+		}
+		bench::doNotOptimize(out.data());
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <harness.hh>
+#include <packed_pq.hh>
+#include <pq.hh>
+#include <pq_alloc.hh>
+
+/*
+ * What dropping the payload buys. Pq<int> with the key as its own
+ * payload (what sorting numbers used to do) against the key only
+ * KeyPq, for arity 2 and 4, then a Pq<std::uint32_t> carrying an index
+ * against PackedPq with the index packed into the key. Each queue is
+ * filled with n random keys, runs a hold model and is drained. Bytes per
+ * item at the end of the fill and at the peak (vector growth briefly
+ * holds old and new storage) are noted from a CountingResource.
+ * Usage: bench_compact [maxN] [holdOps]. 10^8 needs about 2 GB.
+ */
+
+template<typename Q>
+void push(Q& q, int key, std::uint32_t) {
+	q.enqueue(key, key);
+}
+
+template<std::size_t Arity>
+void push(KeyPq<int, Arity>& q, int key, std::uint32_t) {
+	q.enqueue(key);
+}
+
+template<std::size_t Arity>
+void push(Pq<std::uint32_t, Arity>& q, int key, std::uint32_t idx) {
+	q.enqueue(idx, key);
+}
+
+template<typename T, std::size_t Arity>
+void push(PackedPq<T, int, std::greater<int>, Arity>& q, int key, std::uint32_t idx) {
+	q.enqueue(idx, key);
+}
+
+template<typename Q>
+void run(const std::string& name, const std::vector<int>& keys, std::size_t n, std::size_t holdOps) {
+	Q q;
+	auto start = bench::Clock::now();
+	for (std::size_t i = 0; i < n; i++) {
+		push(q, keys[i], static_cast<std::uint32_t>(i));
+	}
+	bench::report("fill " + name, n, n, bench::nsSince(start));
+
+	long long sum = 0;
+	start = bench::Clock::now();
+	for (std::size_t i = 0; i < holdOps; i++) {
+		sum += q.dequeue();
+		push(q, keys[n + i], static_cast<std::uint32_t>(i));
+	}
+	bench::report("hold " + name, n, holdOps, bench::nsSince(start));
+
+	std::vector<long long> out(4096);
+	start = bench::Clock::now();
+	while (std::size_t got = q.dequeueBatch(out.size(), out.begin())) {
+		sum += out[got - 1];
+	}
+	bench::report("drain " + name, n, n, bench::nsSince(start));
+	bench::doNotOptimize(sum);
+}
+
+template<typename Q>
+void footprint(const char* name, const std::vector<int>& keys, std::size_t n) {
+	CountingResource counter;
+	{
+		Q q{std::pmr::polymorphic_allocator<int>(&counter)};
+		for (std::size_t i = 0; i < n; i++) {
+			push(q, keys[i], static_cast<std::uint32_t>(i));
+		}
+		AllocStats s = counter.stats();
+		bench::note("  %-10s %zu items: %5.2f bytes per item live, %5.2f at peak\n", name, n,
+			static_cast<double>(s.liveBytes) / n, static_cast<double>(s.peakBytes) / n);
+	}
+}
+
+template<std::size_t Arity>
+using PmrIntPq = Pq<int, Arity, int, std::greater<int>, std::pmr::polymorphic_allocator<int> >;
+
+template<std::size_t Arity>
+using PmrKeyPq = Pq<void, Arity, int, std::greater<int>, std::pmr::polymorphic_allocator<int> >;
+
+template<std::size_t Arity>
+void push(PmrKeyPq<Arity>& q, int key, std::uint32_t) {
+	q.enqueue(key);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::size_t holdOps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+	for (std::size_t n = 1000000; n <= maxN; n *= 10) {
+		std::vector<int> keys = bench::randomKeys(n + holdOps, 97);
+
+		footprint<PmrIntPq<2> >("Pq<int>", keys, n);
+		footprint<PmrKeyPq<2> >("KeyPq<int>", keys, n);
+
+		run<Pq<int, 2> >("Pq<int, 2>", keys, n, holdOps);
+		run<KeyPq<int, 2> >("KeyPq<int, 2>", keys, n, holdOps);
+		run<Pq<int, 4> >("Pq<int, 4>", keys, n, holdOps);
+		run<KeyPq<int, 4> >("KeyPq<int, 4>", keys, n, holdOps);
+		run<Pq<std::uint32_t, 4> >("Pq<uint32_t, 4> index", keys, n, holdOps);
+		run<PackedPq<std::uint32_t, int, std::greater<int>, 4> >("PackedPq<uint32_t, int> index",
+			keys, n, holdOps);
+	}
+	return 0;
+}
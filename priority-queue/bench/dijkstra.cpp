@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * Single source shortest paths on a random sparse graph. The lazy
+ * variants re-insert a node every time its distance improves and skip
+ * stale entries when they surface, the addressable variant keeps one
+ * entry per node and calls updateKey. Reports time per edge and the
+ * peak number of entries held by the queue.
+ */
+
+using Dist = std::uint64_t;
+const Dist INF = std::numeric_limits<Dist>::max();
+
+struct Graph {
+	std::vector<std::uint32_t> offsets;
+	std::vector<std::uint32_t> targets;
+	std::vector<std::uint32_t> weights;
+};
+
+Graph randomGraph(std::uint32_t n, std::uint32_t degree, std::uint64_t seed) {
+	std::mt19937_64 gen(seed);
+	Graph g;
+	g.offsets.push_back(0);
+	for (std::uint32_t v = 0; v < n; v++) {
+		for (std::uint32_t e = 0; e < degree; e++) {
+			g.targets.push_back(gen() % n);
+			g.weights.push_back(1 + gen() % 1000);
+		}
+		g.offsets.push_back(g.targets.size());
+	}
+	return g;
+}
+
+template<typename Q>
+std::vector<Dist> lazy(const Graph& g, std::size_t& peak) {
+	std::vector<Dist> dist(g.offsets.size() - 1, INF);
+	Q q;
+	dist[0] = 0;
+	q.enqueue(std::make_pair(0u, Dist(0)), 0);
+	peak = 1;
+	while (!q.isEmpty()) {
+		// the key rides along in the payload so stale entries can be spotted
+		std::pair<std::uint32_t, Dist> top = q.dequeue();
+		std::uint32_t v = top.first;
+		if (top.second != dist[v]) {
+			continue;
+		}
+		for (std::uint32_t e = g.offsets[v]; e < g.offsets[v + 1]; e++) {
+			Dist nd = dist[v] + g.weights[e];
+			std::uint32_t u = g.targets[e];
+			if (nd < dist[u]) {
+				dist[u] = nd;
+				q.enqueue(std::make_pair(u, nd), nd);
+			}
+		}
+		if ((std::size_t)q.count() > peak) {
+			peak = q.count();
+		}
+	}
+	return dist;
+}
+
+template<std::size_t Arity>
+std::vector<Dist> addressable(const Graph& g, std::size_t& peak) {
+	typedef AddressablePq<std::uint32_t, Arity, Dist, std::less<Dist> > Q;
+	std::size_t n = g.offsets.size() - 1;
+	std::vector<Dist> dist(n, INF);
+	std::vector<typename Q::Handle> handles(n);
+	std::vector<bool> queued(n, false);
+	Q q;
+	dist[0] = 0;
+	handles[0] = q.enqueue(0, 0);
+	queued[0] = true;
+	peak = 1;
+	while (!q.isEmpty()) {
+		std::uint32_t v = q.dequeue();
+		queued[v] = false;
+		for (std::uint32_t e = g.offsets[v]; e < g.offsets[v + 1]; e++) {
+			Dist nd = dist[v] + g.weights[e];
+			std::uint32_t u = g.targets[e];
+			if (nd < dist[u]) {
+				dist[u] = nd;
+				if (queued[u]) {
+					q.updateKey(handles[u], nd);
+				} else {
+					handles[u] = q.enqueue(u, nd);
+					queued[u] = true;
+				}
+			}
+		}
+		if ((std::size_t)q.count() > peak) {
+			peak = q.count();
+		}
+	}
+	return dist;
+}
+
+template<typename F>
+void run(const char* name, const Graph& g, const std::vector<Dist>& expect, F solve) {
+	std::size_t peak = 0;
+	auto start = bench::Clock::now();
+	std::vector<Dist> dist = solve(g, peak);
+	double ns = bench::nsSince(start);
+	if (dist != expect) {
+		std::fprintf(stderr, "%s produced wrong distances\n", name);
+		std::exit(1);
+	}
+	bench::report(name, g.offsets.size() - 1, g.targets.size(), ns);
+	bench::note("%-40s peak queue entries %zu\n", name, peak);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::uint32_t maxN = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+
+	typedef std::pair<std::uint32_t, Dist> Entry;
+	for (std::uint32_t n = 10000; n <= maxN; n *= 20) {
+		Graph g = randomGraph(n, 8, 3);
+		std::size_t peak;
+		std::vector<Dist> expect = lazy<MinPq<Entry, Dist> >(g, peak);
+
+		run("lazy binary", g, expect, lazy<MinPq<Entry, Dist> >);
+		run("lazy 4-ary", g, expect, lazy<MinPq<Entry, Dist, 4> >);
+		run("lazy radix", g, expect, lazy<Pq<Entry, 2, Dist, MonotoneLess<Dist> > >);
+		run("addressable binary", g, expect, addressable<2>);
+		run("addressable 4-ary", g, expect, addressable<4>);
+	}
+	return 0;
+}
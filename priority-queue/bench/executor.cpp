@@ -0,0 +1,98 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <executor.hh>
+#include <harness.hh>
+
+/*
+ * Tail latency of urgent work on a saturated pool. A producer keeps a
+ * backlog of 50us low priority tasks queued for every worker and submits
+ * a 5us high priority task every 500us. The queueing delay of each kind
+ * (submit to start) is measured inside the tasks. The same load runs
+ * twice, once with the high tasks in a higher class and once with
+ * everything in one class, which is the FIFO a plain thread pool gives.
+ * Usage: bench_executor [workers] [seconds]
+ */
+
+const std::chrono::microseconds LOW_WORK(50);
+const std::chrono::microseconds HIGH_WORK(5);
+const std::chrono::microseconds HIGH_PERIOD(500);
+const std::size_t BACKLOG_PER_WORKER = 32;
+
+void spin(std::chrono::microseconds work) {
+	auto start = bench::Clock::now();
+	while (bench::Clock::now() - start < work) {
+	}
+}
+
+struct Delays {
+	std::mutex lock;
+	bench::Sampler samples{1};
+
+	void add(bench::Clock::time_point submitted) {
+		double ns = bench::nsSince(submitted);
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->samples.add(ns, 1);
+	}
+};
+
+void run(const std::string& label, std::size_t workers, double seconds, bool prioritized) {
+	Executor ex(workers, 2);
+	Delays low;
+	Delays high;
+	std::atomic<std::size_t> lowDone{0};
+	std::size_t lowSubmitted = 0;
+	std::size_t highSubmitted = 0;
+	std::size_t backlog = BACKLOG_PER_WORKER * workers;
+
+	auto start = bench::Clock::now();
+	auto end = start + std::chrono::duration<double>(seconds);
+	auto nextHigh = start;
+	while (bench::Clock::now() < end) {
+		auto now = bench::Clock::now();
+		if (now >= nextHigh) {
+			ex.submit(prioritized ? 1 : 0, [&high, now]() {
+				high.add(now);
+				spin(HIGH_WORK);
+			});
+			highSubmitted++;
+			nextHigh += HIGH_PERIOD;
+		}
+		while (lowSubmitted - lowDone.load(std::memory_order_relaxed) < backlog) {
+			auto submitted = bench::Clock::now();
+			ex.submit(0, [&low, &lowDone, submitted]() {
+				low.add(submitted);
+				spin(LOW_WORK);
+				lowDone.fetch_add(1, std::memory_order_relaxed);
+			});
+			lowSubmitted++;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	ex.waitIdle();
+
+	bench::report("high delay " + label, workers, highSubmitted, high.samples);
+	bench::report("low delay " + label, workers, lowSubmitted, low.samples);
+	if (prioritized) {
+		std::vector<ExecutorClassStats> stats = ex.stats();
+		for (std::size_t c = 0; c < stats.size(); c++) {
+			bench::note("  class %zu: %llu run, queue delay p99 < %llu ns, run time p99 < %llu ns\n", c,
+				static_cast<unsigned long long>(stats[c].completed),
+				static_cast<unsigned long long>(stats[c].queueDelay.percentile(0.99)),
+				static_cast<unsigned long long>(stats[c].runTime.percentile(0.99)));
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t workers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+	double seconds = argc > 2 ? std::strtod(argv[2], nullptr) : 2;
+
+	run("prioritized", workers, seconds, true);
+	run("one class", workers, seconds, false);
+	return 0;
+}
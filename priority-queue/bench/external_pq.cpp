@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <sys/resource.h>
+#include <harness.hh>
+#include <external_pq.hh>
+#include <pq.hh>
+
+/*
+ * ExternalPq with data many times its memory budget. Fills n records
+ * (int key, 8 byte payload), then drains them, then runs a hold model
+ * (dequeue one, enqueue one) at full size. Keys are generated on the fly
+ * so the bench itself holds nothing. Peak RSS is read from getrusage
+ * after the external runs and reported next to the budget, then the same
+ * fill and drain on an in-memory Pq is timed for reference when it fits.
+ * Usage: bench_external_pq [dataMiB] [budgetMiB] [tempDir]
+ */
+
+struct Record {
+	int key;
+	std::uint64_t payload;
+};
+
+struct KeyGen {
+	std::uint64_t state;
+
+	int next() {
+		this->state ^= this->state >> 12;
+		this->state ^= this->state << 25;
+		this->state ^= this->state >> 27;
+		return static_cast<int>((this->state * 0x2545F4914F6CDD1DULL) >> 34);
+	}
+};
+
+double peakRssMiB() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+template<typename Q>
+void fillDrain(const std::string& name, Q& q, std::size_t n) {
+	KeyGen gen{0x9E3779B97F4A7C15ULL};
+	auto start = bench::Clock::now();
+	for (std::size_t i = 0; i < n; i++) {
+		q.enqueue(i, gen.next());
+	}
+	bench::report(name + "/fill", n, n, bench::nsSince(start));
+
+	std::size_t holdOps = n / 4;
+	start = bench::Clock::now();
+	std::uint64_t sum = 0;
+	for (std::size_t i = 0; i < holdOps; i++) {
+		sum += q.dequeue();
+		q.enqueue(i, gen.next());
+	}
+	bench::report(name + "/hold", n, holdOps, bench::nsSince(start));
+
+	start = bench::Clock::now();
+	while (!q.isEmpty()) {
+		sum += q.dequeue();
+	}
+	bench::report(name + "/drain", n, n, bench::nsSince(start));
+	bench::doNotOptimize(sum);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t dataMiB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512;
+	std::size_t budgetMiB = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+	std::string dir = argc > 3 ? argv[3] : ExternalPq<std::uint64_t>::defaultTempDir();
+
+	// bytes one record takes on disk
+	std::size_t n = (dataMiB << 20) / sizeof(Record);
+	{
+		ExternalPq<std::uint64_t> q(budgetMiB << 20, dir);
+		fillDrain("ExternalPq budget=" + std::to_string(budgetMiB) + "MiB", q, n);
+		bench::note("  %zu MiB of records, budget %zu MiB, peak RSS %.1f MiB, %.1f MiB spilled\n",
+			dataMiB, budgetMiB, peakRssMiB(), q.bytesSpilled() / 1048576.0);
+	}
+
+	// the same workload in memory, skipped when it would not fit comfortably
+	if (dataMiB <= 1024) {
+		Pq<std::uint64_t, 4> q;
+		fillDrain("Pq<4> in memory", q, n);
+		bench::note("  peak RSS after the in-memory run %.1f MiB\n", peakRssMiB());
+	}
+	return 0;
+}
@@ -0,0 +1,284 @@
+#ifndef BENCH_HARNESS_H
+
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Tiny dependency free helpers shared by the benchmark binaries.
+ * Everything is header only so each bench is a single translation unit.
+ *
+ * Every bench accepts --csv or --json anywhere on its command line.
+ * Results then go to stdout as CSV rows (one header line first) or as
+ * one JSON object per line, with a fixed set of columns so runs from two
+ * commits can be diffed or joined on name and n. Anything that is not a
+ * timing row goes through note(), which moves to stderr in those modes.
+ */
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Format {
+	TEXT,
+	CSV,
+	JSON,
+};
+
+inline Format& outputFormat() {
+	static Format format = Format::TEXT;
+	return format;
+}
+
+// pulls --csv / --json out of argv so positional arguments keep their index
+inline int parseFormat(int argc, char** argv) {
+	int kept = 1;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--csv") == 0) {
+			outputFormat() = Format::CSV;
+		} else if (std::strcmp(argv[i], "--json") == 0) {
+			outputFormat() = Format::JSON;
+		} else {
+			argv[kept++] = argv[i];
+		}
+	}
+	return kept;
+}
+
+// keep the optimizer from throwing away a result we never read
+template<typename V>
+inline void doNotOptimize(const V& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline double nsSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+inline std::vector<int> randomKeys(std::size_t n, std::uint64_t seed) {
+	std::mt19937_64 gen(seed);
+	std::uniform_int_distribution<int> dist(0, 1 << 30);
+	std::vector<int> out(n);
+	for (std::size_t i = 0; i < n; i++) {
+		out[i] = dist(gen);
+	}
+	return out;
+}
+
+enum class Distribution {
+	RANDOM,
+	SORTED,
+	REVERSE,
+	// only 16 distinct keys
+	DUPLICATES,
+};
+
+inline const char* distributionName(Distribution dist) {
+	switch (dist) {
+	case Distribution::SORTED: return "sorted";
+	case Distribution::REVERSE: return "reverse";
+	case Distribution::DUPLICATES: return "duplicates";
+	default: return "random";
+	}
+}
+
+inline std::vector<int> makeKeys(Distribution dist, std::size_t n, std::uint64_t seed) {
+	std::vector<int> out = randomKeys(n, seed);
+	switch (dist) {
+	case Distribution::SORTED:
+		std::sort(out.begin(), out.end());
+		break;
+	case Distribution::REVERSE:
+		std::sort(out.rbegin(), out.rend());
+		break;
+	case Distribution::DUPLICATES:
+		for (int& k : out) {
+			k &= 15;
+		}
+		break;
+	default: break;
+	}
+	return out;
+}
+
+/*
+ * Collects the time of fixed size batches of operations so percentiles
+ * can be reported per op without paying a clock read per op.
+ */
+class Sampler {
+	public:
+		explicit Sampler(std::size_t batch) : batch(batch), total(0) {}
+
+		std::size_t batchSize() const {
+			return this->batch;
+		}
+
+		void add(double ns, std::size_t ops) {
+			this->perOp.push_back(ns / ops);
+			this->total += ns;
+		}
+
+		double totalNs() const {
+			return this->total;
+		}
+
+		// ns per op at quantile q of the recorded batches
+		double percentile(double q) {
+			if (this->perOp.empty()) {
+				return 0;
+			}
+			std::size_t idx = q * (this->perOp.size() - 1);
+			std::nth_element(this->perOp.begin(), this->perOp.begin() + idx, this->perOp.end());
+			return this->perOp[idx];
+		}
+
+	private:
+		std::size_t batch;
+		double total;
+		std::vector<double> perOp;
+};
+
+inline void emit(const std::string& name, std::size_t n, std::size_t ops, double ns,
+	double p50, double p90, double p99) {
+	static bool headerDone = false;
+	double nsPerOp = ns / ops;
+	double mops = 1e3 / nsPerOp;
+
+	switch (outputFormat()) {
+	case Format::CSV:
+		if (!headerDone) {
+			std::printf("name,n,ops,ns_per_op,mops_per_s,p50_ns,p90_ns,p99_ns\n");
+			headerDone = true;
+		}
+		std::printf("%s,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			name.c_str(), n, ops, nsPerOp, mops, p50, p90, p99);
+		break;
+	case Format::JSON:
+		std::printf("{\"name\":\"%s\",\"n\":%zu,\"ops\":%zu,\"ns_per_op\":%.3f,"
+			"\"mops_per_s\":%.3f,\"p50_ns\":%.3f,\"p90_ns\":%.3f,\"p99_ns\":%.3f}\n",
+			name.c_str(), n, ops, nsPerOp, mops, p50, p90, p99);
+		break;
+	default:
+		if (p99 > 0) {
+			std::printf("%-40s n=%-10zu %10.2f ns/op %10.2f Mops/s  p50 %.1f p90 %.1f p99 %.1f\n",
+				name.c_str(), n, nsPerOp, mops, p50, p90, p99);
+		} else {
+			std::printf("%-40s n=%-10zu %10.2f ns/op %10.2f Mops/s\n",
+				name.c_str(), n, nsPerOp, mops);
+		}
+		break;
+	}
+}
+
+// one aggregate timing, no percentiles
+inline void report(const std::string& name, std::size_t n, std::size_t ops, double ns) {
+	emit(name, n, ops, ns, 0, 0, 0);
+}
+
+inline void report(const std::string& name, std::size_t n, std::size_t ops, Sampler& sampler) {
+	emit(name, n, ops, sampler.totalNs(),
+		sampler.percentile(0.5), sampler.percentile(0.9), sampler.percentile(0.99));
+}
+
+/*
+ * Hardware event counts for the calling thread via perf_event_open:
+ * data TLB read misses and last level cache misses. Containers, VMs and
+ * perf_event_paranoid often leave them unavailable, in which case
+ * available() is false and the bench only reports time.
+ */
+class PerfCounters {
+	public:
+		enum Event {
+			DTLB_MISSES,
+			LLC_MISSES,
+			EVENTS,
+		};
+
+		PerfCounters() {
+			const std::uint64_t configs[EVENTS] = {
+				PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+					(PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+				PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+					(PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			};
+			for (int e = 0; e < EVENTS; e++) {
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HW_CACHE;
+				attr.config = configs[e];
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				this->fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+			}
+		}
+
+		~PerfCounters() {
+			for (int e = 0; e < EVENTS; e++) {
+				if (this->fds[e] >= 0) {
+					close(this->fds[e]);
+				}
+			}
+		}
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		bool available(Event e) const {
+			return this->fds[e] >= 0;
+		}
+
+		void start() {
+			for (int e = 0; e < EVENTS; e++) {
+				if (this->fds[e] >= 0) {
+					ioctl(this->fds[e], PERF_EVENT_IOC_RESET, 0);
+					ioctl(this->fds[e], PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+		}
+
+		void stop() {
+			for (int e = 0; e < EVENTS; e++) {
+				if (this->fds[e] >= 0) {
+					ioctl(this->fds[e], PERF_EVENT_IOC_DISABLE, 0);
+				}
+			}
+		}
+
+		// count since the last start(), 0 when the event is unavailable
+		std::uint64_t read(Event e) const {
+			std::uint64_t value = 0;
+			if (this->fds[e] < 0 || ::read(this->fds[e], &value, sizeof(value)) != sizeof(value)) {
+				return 0;
+			}
+			return value;
+		}
+
+	private:
+		int fds[EVENTS];
+};
+
+// free form text, kept off stdout when stdout is machine readable
+inline void note(const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	std::vfprintf(outputFormat() == Format::TEXT ? stdout : stderr, fmt, args);
+	va_end(args);
+}
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include <cstdlib>
+#include <string>
+#include <harness.hh>
+#include <legacy_pq.hh>
+#include <pq.hh>
+
+/*
+ * Flat key/payload storage versus the old vector<unique_ptr<HeapNode>>.
+ * Fill a queue with n random keys then drain it, timing each phase.
+ */
+
+template<typename Q>
+void run(const char* name, const std::vector<int>& keys) {
+	Q q;
+	auto start = bench::Clock::now();
+	for (int k : keys) {
+		q.enqueue(k, k);
+	}
+	double enqNs = bench::nsSince(start);
+
+	long long sum = 0;
+	start = bench::Clock::now();
+	while (!q.isEmpty()) {
+		sum += q.dequeue();
+	}
+	double deqNs = bench::nsSince(start);
+	bench::doNotOptimize(sum);
+
+	std::string label(name);
+	bench::report((label + " enqueue").c_str(), keys.size(), keys.size(), enqNs);
+	bench::report((label + " dequeue").c_str(), keys.size(), keys.size(), deqNs);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+	for (std::size_t n = 1000; n <= maxN; n *= 10) {
+		std::vector<int> keys = bench::randomKeys(n, 42);
+		run<Pq<int> >("flat", keys);
+		run<LegacyPq<int> >("legacy", keys);
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef LEGACY_PQ_H
+
+#define LEGACY_PQ_H
+
+#include <memory>
+#include <vector>
+
+/*
+ * The original node per allocation layout, kept only so the benchmarks
+ * have something to compare the flat storage against.
+ */
+template<typename T>
+struct LegacyHeapNode {
+	int key;
+	T val;
+};
+
+template<typename T>
+class LegacyPq {
+	public:
+		void enqueue(const T& item, int priority) {
+			this->internalHeap.push_back(
+				std::make_unique<LegacyHeapNode<T>>(LegacyHeapNode<T>{priority, item})
+			);
+
+			int curr = this->internalHeap.size() - 1;
+			while (curr > 0) {
+				int parent = (curr - 1) / 2;
+				if (this->internalHeap[parent]->key > priority) {
+					break;
+				}
+				std::swap(this->internalHeap[parent], this->internalHeap[curr]);
+				curr = parent;
+			}
+		}
+
+		T dequeue() {
+			std::unique_ptr<LegacyHeapNode<T> > resultN = std::move(this->internalHeap.at(0));
+			this->internalHeap[0] = std::move(this->internalHeap.back());
+			this->internalHeap.pop_back();
+
+			int limit = this->internalHeap.size();
+			int curr = 0;
+			while (curr < limit) {
+				int l = 2 * curr + 1;
+				int r = 2 * curr + 2;
+				int swapWith = curr;
+				if (l < limit && this->internalHeap[l]->key > this->internalHeap[swapWith]->key) {
+					swapWith = l;
+				}
+				if (r < limit && this->internalHeap[r]->key > this->internalHeap[swapWith]->key) {
+					swapWith = r;
+				}
+				if (swapWith == curr) {
+					break;
+				}
+				std::swap(this->internalHeap[curr], this->internalHeap[swapWith]);
+				curr = swapWith;
+			}
+			return resultN->val;
+		}
+
+		bool isEmpty() const {
+			return this->internalHeap.empty();
+		}
+
+	private:
+		std::vector<std::unique_ptr<LegacyHeapNode<T> > > internalHeap;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <harness.hh>
+#include <loser_tree.hh>
+#include <pq.hh>
+
+/*
+ * K-way merge of K sorted runs of ints, n elements in total, for K from
+ * 2 to 4096. The Pq merges keep one head per run keyed by its value,
+ * either popping and pushing the next head or replacing the top in
+ * place. LoserTree is timed one dequeue at a time and in batches into a
+ * caller buffer. Comparisons per element are noted for Pq<4> and the
+ * loser tree.
+ * Usage: bench_merge [n]
+ */
+
+typedef std::vector<int>::const_iterator It;
+
+struct CountingLess {
+	std::uint64_t* count;
+
+	bool operator()(int a, int b) const {
+		++*this->count;
+		return a < b;
+	}
+};
+
+template<std::size_t Arity>
+void pqPopPush(const std::vector<std::vector<int> >& runs, std::vector<int>& out) {
+	MinPq<std::uint32_t, int, Arity> heads;
+	std::vector<It> cur;
+	for (std::size_t r = 0; r < runs.size(); r++) {
+		cur.push_back(runs[r].begin());
+		heads.enqueue(r, runs[r].front());
+	}
+	std::size_t i = 0;
+	while (!heads.isEmpty()) {
+		std::uint32_t r = heads.dequeue();
+		out[i++] = *cur[r];
+		if (++cur[r] != runs[r].end()) {
+			heads.enqueue(r, *cur[r]);
+		}
+	}
+}
+
+template<typename Q>
+void pqReplaceTop(Q& heads, const std::vector<std::vector<int> >& runs, std::vector<int>& out) {
+	std::vector<It> cur;
+	for (std::size_t r = 0; r < runs.size(); r++) {
+		cur.push_back(runs[r].begin());
+		heads.enqueue(r, runs[r].front());
+	}
+	std::size_t i = 0;
+	while (!heads.isEmpty()) {
+		std::uint32_t r = heads.peek();
+		out[i++] = *cur[r];
+		if (++cur[r] != runs[r].end()) {
+			heads.replaceTop(r, *cur[r]);
+		} else {
+			heads.dequeue();
+		}
+	}
+}
+
+std::vector<LoserTree<It>::Range> rangesOf(const std::vector<std::vector<int> >& runs) {
+	std::vector<LoserTree<It>::Range> ranges;
+	for (const std::vector<int>& run : runs) {
+		ranges.emplace_back(run.begin(), run.end());
+	}
+	return ranges;
+}
+
+void loserOneByOne(const std::vector<std::vector<int> >& runs, std::vector<int>& out) {
+	LoserTree<It> tree(rangesOf(runs));
+	std::size_t i = 0;
+	while (!tree.isEmpty()) {
+		out[i++] = tree.dequeue();
+	}
+}
+
+void loserBatched(const std::vector<std::vector<int> >& runs, std::vector<int>& out) {
+	LoserTree<It> tree(rangesOf(runs));
+	int buffer[4096];
+	std::size_t i = 0;
+	while (std::size_t got = tree.dequeueBatch(4096, buffer)) {
+		std::copy(buffer, buffer + got, out.begin() + i);
+		i += got;
+	}
+}
+
+void time(const std::string& name, std::size_t n, void (*merge)(const std::vector<std::vector<int> >&,
+	std::vector<int>&), const std::vector<std::vector<int> >& runs, std::vector<int>& out) {
+	auto start = bench::Clock::now();
+	merge(runs, out);
+	bench::report(name, n, n, bench::nsSince(start));
+	bench::doNotOptimize(out.back());
+}
+
+void replaceTop4(const std::vector<std::vector<int> >& runs, std::vector<int>& out) {
+	MinPq<std::uint32_t, int, 4> heads;
+	pqReplaceTop(heads, runs, out);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 22);
+
+	std::vector<int> keys = bench::randomKeys(n, 83);
+	std::vector<int> out(n);
+	for (std::size_t k = 2; k <= 4096 && k <= n; k *= 2) {
+		std::vector<std::vector<int> > runs(k);
+		for (std::size_t i = 0; i < n; i++) {
+			runs[i % k].push_back(keys[i]);
+		}
+		for (std::vector<int>& run : runs) {
+			std::sort(run.begin(), run.end());
+		}
+
+		std::string label = " K=" + std::to_string(k);
+		time("Pq<2> pop+push" + label, n, pqPopPush<2>, runs, out);
+		time("Pq<4> pop+push" + label, n, pqPopPush<4>, runs, out);
+		time("Pq<4> replaceTop" + label, n, replaceTop4, runs, out);
+		time("LoserTree dequeue" + label, n, loserOneByOne, runs, out);
+		time("LoserTree dequeueBatch" + label, n, loserBatched, runs, out);
+
+		InstrumentedPq<std::uint32_t, 4, int, std::less<int> > counted;
+		pqReplaceTop(counted, runs, out);
+		std::uint64_t treeCompares = 0;
+		LoserTree<It, CountingLess> tree(rangesOf(runs), CountingLess{&treeCompares});
+		tree.drainInto(out.begin());
+		bench::note("  K=%zu compares/element: Pq<4> replaceTop %.2f, LoserTree %.2f\n", k,
+			static_cast<double>(counted.stats().compares) / n,
+			static_cast<double>(treeCompares) / n);
+	}
+	return 0;
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <harness.hh>
+#include <multi_pq.hh>
+#include <pq.hh>
+
+/*
+ * Scaling of MultiPq against one Pq behind a global mutex. Every thread
+ * alternates enqueue and dequeue on a prefilled queue, 1 to N threads.
+ * The second half measures ordering quality: a single thread drains a
+ * prefilled MultiPq and for every pop we count how many queued keys were
+ * better than the one returned (its rank error). The strict queue is 0.
+ */
+
+struct LockedPq {
+	std::mutex mu;
+	Pq<int, 4> pq;
+
+	explicit LockedPq(std::size_t) {}
+
+	void enqueue(int item, int priority) {
+		std::lock_guard<std::mutex> guard(this->mu);
+		this->pq.enqueue(item, priority);
+	}
+
+	std::optional<int> tryDequeue() {
+		std::lock_guard<std::mutex> guard(this->mu);
+		return this->pq.tryDequeue();
+	}
+};
+
+template<typename Q>
+void scaling(const char* name, std::size_t threads, std::size_t prefill,
+	std::size_t opsPerThread, const std::vector<int>& keys) {
+	Q q(4 * threads);
+	for (std::size_t i = 0; i < prefill; i++) {
+		q.enqueue(keys[i], keys[i]);
+	}
+
+	auto start = bench::Clock::now();
+	std::vector<std::thread> workers;
+	for (std::size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&q, &keys, t, opsPerThread]() {
+			long long sum = 0;
+			std::size_t next = t * 7919;
+			for (std::size_t i = 0; i < opsPerThread; i++) {
+				int k = keys[next % keys.size()];
+				next++;
+				q.enqueue(k, k);
+				std::optional<int> v = q.tryDequeue();
+				sum += v ? *v : 0;
+			}
+			bench::doNotOptimize(sum);
+		});
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+	double ns = bench::nsSince(start);
+
+	std::string label = std::string(name) + " threads=" + std::to_string(threads);
+	bench::report(label.c_str(), prefill, 2 * opsPerThread * threads, ns);
+}
+
+// Fenwick tree over key values, counts how many queued keys are above x
+struct Ranks {
+	std::vector<int> tree;
+
+	explicit Ranks(std::size_t n) : tree(n + 1, 0) {}
+
+	void add(std::size_t i, int delta) {
+		for (i++; i < this->tree.size(); i += i & (0 - i)) {
+			this->tree[i] += delta;
+		}
+	}
+
+	int prefix(std::size_t i) const {
+		int sum = 0;
+		for (i++; i > 0; i -= i & (0 - i)) {
+			sum += this->tree[i];
+		}
+		return sum;
+	}
+};
+
+void rankError(std::size_t shards, std::size_t n) {
+	MultiPq<int> q(shards);
+	Ranks ranks(n);
+	// a permutation of 0..n-1 so ranks are exact
+	std::vector<int> keys(n);
+	for (std::size_t i = 0; i < n; i++) {
+		keys[i] = i;
+	}
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(17));
+	for (int k : keys) {
+		q.enqueue(k, k);
+		ranks.add(k, 1);
+	}
+
+	double total = 0;
+	int worst = 0;
+	int live = n;
+	while (std::optional<int> v = q.tryDequeue()) {
+		// keys strictly greater than v are still queued and ranked better
+		int better = live - ranks.prefix(*v);
+		total += better;
+		worst = better > worst ? better : worst;
+		ranks.add(*v, -1);
+		live--;
+	}
+	bench::note("rank error shards=%-4zu n=%-10zu mean %8.2f max %6d\n",
+		shards, n, total / n, worst);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxThreads = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+		: std::thread::hardware_concurrency();
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	maxThreads = maxThreads < 1 ? 1 : maxThreads;
+
+	std::size_t prefill = 1000000;
+	std::vector<int> keys = bench::randomKeys(prefill + ops, 23);
+	for (std::size_t t = 1; t <= maxThreads; t *= 2) {
+		scaling<LockedPq>("global mutex Pq", t, prefill, ops / t, keys);
+		scaling<MultiPq<int> >("MultiPq 4 shards/thread", t, prefill, ops / t, keys);
+	}
+
+	for (std::size_t shards = 4; shards <= 64; shards *= 2) {
+		rankError(shards, 100000);
+	}
+	return 0;
+}
@@ -0,0 +1,186 @@
+#include <cstdlib>
+#include <queue>
+#include <string>
+#include <utility>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * The main regression suite. Workloads:
+ *
+ *   enqueue  n pushes into an empty queue
+ *   dequeue  draining a queue that holds n items
+ *   hold     dequeue + enqueue pairs at a steady size of n
+ *   heapify  building a queue of n from a range in one call
+ *   topk     popping the best n/100 out of n
+ *
+ * each over sorted, reverse, random and many-duplicates keys, for Pq with
+ * arity 2 and 4 and for std::priority_queue<pair<key, payload>>.
+ * Times are taken over batches of 256 ops, p50/p90/p99 are per op.
+ * Usage: bench_pq [maxN] [--csv|--json]
+ */
+
+const std::size_t BATCH = 256;
+
+typedef std::pair<int, int> Entry;
+
+template<std::size_t Arity>
+struct PqImpl {
+	Pq<int, Arity> q;
+
+	static std::string name() {
+		return "Pq<" + std::to_string(Arity) + ">";
+	}
+
+	void push(int k) {
+		this->q.enqueue(k, k);
+	}
+
+	int pop() {
+		return this->q.dequeue();
+	}
+
+	void build(const std::vector<Entry>& entries) {
+		this->q = Pq<int, Arity>(entries.begin(), entries.end());
+	}
+
+	void popMany(std::size_t k, int* out) {
+		this->q.dequeueBatch(k, out);
+	}
+};
+
+struct StdImpl {
+	std::priority_queue<Entry> q;
+
+	static std::string name() {
+		return "std::priority_queue";
+	}
+
+	void push(int k) {
+		this->q.emplace(k, k);
+	}
+
+	int pop() {
+		int v = this->q.top().second;
+		this->q.pop();
+		return v;
+	}
+
+	void build(const std::vector<Entry>& entries) {
+		this->q = std::priority_queue<Entry>(std::less<Entry>(), entries);
+	}
+
+	void popMany(std::size_t k, int* out) {
+		for (std::size_t i = 0; i < k; i++) {
+			out[i] = this->pop();
+		}
+	}
+};
+
+template<typename Impl>
+void runAll(std::size_t n, bench::Distribution dist) {
+	std::vector<int> keys = bench::makeKeys(dist, n, 97);
+	std::vector<Entry> entries;
+	entries.reserve(n);
+	for (int k : keys) {
+		entries.emplace_back(k, k);
+	}
+	std::string suffix = "/" + Impl::name() + "/" + bench::distributionName(dist);
+	long long sink = 0;
+
+	{
+		Impl impl;
+		bench::Sampler sampler(BATCH);
+		for (std::size_t i = 0; i < n; i += BATCH) {
+			std::size_t end = i + BATCH < n ? i + BATCH : n;
+			auto start = bench::Clock::now();
+			for (std::size_t j = i; j < end; j++) {
+				impl.push(keys[j]);
+			}
+			sampler.add(bench::nsSince(start), end - i);
+		}
+		bench::report("enqueue" + suffix, n, n, sampler);
+
+		bench::Sampler drain(BATCH);
+		for (std::size_t i = 0; i < n; i += BATCH) {
+			std::size_t end = i + BATCH < n ? i + BATCH : n;
+			auto start = bench::Clock::now();
+			for (std::size_t j = i; j < end; j++) {
+				sink += impl.pop();
+			}
+			drain.add(bench::nsSince(start), end - i);
+		}
+		bench::report("dequeue" + suffix, n, n, drain);
+	}
+
+	{
+		Impl impl;
+		impl.build(entries);
+		std::size_t ops = 1 << 20;
+		bench::Sampler sampler(BATCH);
+		std::size_t next = 0;
+		for (std::size_t i = 0; i < ops; i += BATCH) {
+			auto start = bench::Clock::now();
+			for (std::size_t j = 0; j < BATCH; j++) {
+				sink += impl.pop();
+				impl.push(keys[next]);
+				next = next + 1 == n ? 0 : next + 1;
+			}
+			sampler.add(bench::nsSince(start), BATCH);
+		}
+		bench::report("hold" + suffix, n, ops, sampler);
+	}
+
+	{
+		// enough repetitions that small sizes still give a distribution
+		std::size_t reps = n < (1 << 20) ? (1 << 20) / n : 1;
+		bench::Sampler sampler(n);
+		for (std::size_t r = 0; r < reps; r++) {
+			Impl impl;
+			auto start = bench::Clock::now();
+			impl.build(entries);
+			sampler.add(bench::nsSince(start), n);
+			sink += impl.pop();
+		}
+		bench::report("heapify" + suffix, n, n * reps, sampler);
+	}
+
+	{
+		std::size_t k = n / 100 > 0 ? n / 100 : 1;
+		std::size_t reps = k < (1 << 16) ? (1 << 16) / k : 1;
+		std::vector<int> out(k);
+		bench::Sampler sampler(k);
+		for (std::size_t r = 0; r < reps; r++) {
+			Impl impl;
+			impl.build(entries);
+			auto start = bench::Clock::now();
+			impl.popMany(k, out.data());
+			sampler.add(bench::nsSince(start), k);
+			sink += out[k - 1];
+		}
+		bench::report("topk" + suffix, n, k * reps, sampler);
+	}
+
+	bench::doNotOptimize(sink);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 20);
+
+	const bench::Distribution dists[] = {
+		bench::Distribution::RANDOM,
+		bench::Distribution::SORTED,
+		bench::Distribution::REVERSE,
+		bench::Distribution::DUPLICATES,
+	};
+
+	for (std::size_t n = 1u << 10; n <= maxN; n <<= 5) {
+		for (bench::Distribution dist : dists) {
+			runAll<PqImpl<2> >(n, dist);
+			runAll<PqImpl<4> >(n, dist);
+			runAll<StdImpl>(n, dist);
+		}
+	}
+	return 0;
+}
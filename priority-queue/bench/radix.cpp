@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * Monotone hold model, the shape of a discrete event simulation or a
+ * Dijkstra run: pop the earliest timestamp and schedule a new event a
+ * random delay after it. Binary and 4-ary min heaps over 64-bit keys
+ * against the radix heap selected by MonotoneLess.
+ */
+
+template<typename Q>
+void run(const char* name, std::size_t n, const std::vector<int>& delays, std::size_t ops) {
+	Q q;
+	for (std::size_t i = 0; i < n; i++) {
+		std::uint64_t key = delays[i];
+		q.enqueue(key, key);
+	}
+
+	std::uint64_t sum = 0;
+	std::size_t next = n;
+	auto start = bench::Clock::now();
+	for (std::size_t i = 0; i < ops; i++) {
+		std::uint64_t now = q.dequeue();
+		sum += now;
+		std::uint64_t key = now + delays[next];
+		q.enqueue(key, key);
+		next = next + 1 == delays.size() ? 0 : next + 1;
+	}
+	double ns = bench::nsSince(start);
+	bench::doNotOptimize(sum);
+	bench::report(name, n, ops, ns);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 22);
+	std::size_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+	using Key = std::uint64_t;
+	for (std::size_t n = 1u << 10; n <= maxN; n <<= 3) {
+		std::vector<int> delays = bench::randomKeys(n + ops, 5);
+		run<Pq<Key, 2, Key, std::less<Key> > >("binary min heap", n, delays, ops);
+		run<Pq<Key, 4, Key, std::less<Key> > >("4-ary min heap", n, delays, ops);
+		run<Pq<Key, 2, Key, MonotoneLess<Key> > >("radix heap", n, delays, ops);
+	}
+	return 0;
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <harness.hh>
+#include <pq.hh>
+#include <pq_sort.hh>
+
+#ifdef PQ_BENCH_PAR
+#include <execution>
+#endif
+
+/*
+ * Sorting n random ints: std::sort, the serial Pq fill-and-drain that
+ * examples/sort.cpp used to do, the same with a key only KeyPq built by
+ * heapify, in-place heapSort, pqSort across all cores and, when built
+ * against TBB, std::sort(std::execution::par).
+ * Usage: bench_sort [maxN] [threads]. 10^9 ints needs ~8 GB for pqSort.
+ */
+
+template<typename F>
+void run(const char* name, const std::vector<int>& input, F sortFn) {
+	std::vector<int> data(input);
+	auto start = bench::Clock::now();
+	sortFn(data);
+	double ns = bench::nsSince(start);
+	if (!std::is_sorted(data.begin(), data.end())) {
+		std::fprintf(stderr, "%s did not sort\n", name);
+		std::exit(1);
+	}
+	bench::report(name, input.size(), input.size(), ns);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t maxN = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+		: std::thread::hardware_concurrency();
+
+	for (std::size_t n = 1000000; n <= maxN; n *= 10) {
+		std::vector<int> input = bench::randomKeys(n, 31);
+
+		run("std::sort", input, [](std::vector<int>& v) {
+			std::sort(v.begin(), v.end());
+		});
+		run("serial Pq drain", input, [](std::vector<int>& v) {
+			MinPq<int> pq;
+			for (int x : v) {
+				pq.enqueue(x, x);
+			}
+			pq.dequeueBatch(v.size(), v.begin());
+		});
+		run("serial KeyPq drain", input, [](std::vector<int>& v) {
+			KeyPq<int, 4, std::less<int> > pq(v.begin(), v.end());
+			pq.dequeueBatch(v.size(), v.begin());
+		});
+		run("heapSort in place", input, [](std::vector<int>& v) {
+			heapSort(v.begin(), v.end());
+		});
+		run("pqSort", input, [threads](std::vector<int>& v) {
+			pqSort(v.begin(), v.end(), threads);
+		});
+#ifdef PQ_BENCH_PAR
+		run("std::sort(par)", input, [](std::vector<int>& v) {
+			std::sort(std::execution::par, v.begin(), v.end());
+		});
+#endif
+	}
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <string>
+#include <harness.hh>
+#include <pq.hh>
+
+/*
+ * What the stats policies report and what they cost. For each key
+ * distribution and arity an InstrumentedPq is filled with n keys and
+ * drained, and comparisons, moves and average sift depth per operation
+ * are printed as notes. Then the same hold model runs with NoStats,
+ * CountingStats and ProfilingStats to show the overhead of each.
+ * Usage: bench_stats [n]
+ */
+
+template<std::size_t Arity>
+void counts(std::size_t n, bench::Distribution dist) {
+	std::vector<int> keys = bench::makeKeys(dist, n, 71);
+	InstrumentedPq<int, Arity> q;
+	for (std::size_t i = 0; i < n; i++) {
+		q.enqueue(i, keys[i]);
+	}
+	PqStatsSnapshot fill = q.stats();
+	q.resetStats();
+	while (!q.isEmpty()) {
+		q.dequeue();
+	}
+	PqStatsSnapshot drain = q.stats();
+
+	bench::note("%-10s arity %zu  enqueue: %6.2f compares %6.2f moves  max depth %2llu"
+		"   dequeue: %6.2f compares %6.2f moves  max depth %2llu\n",
+		bench::distributionName(dist), Arity,
+		static_cast<double>(fill.compares) / n, static_cast<double>(fill.moves) / n,
+		static_cast<unsigned long long>(fill.maxSiftUp),
+		static_cast<double>(drain.compares) / n, static_cast<double>(drain.moves) / n,
+		static_cast<unsigned long long>(drain.maxSiftDown));
+}
+
+template<typename Stats>
+void overhead(const char* name, std::size_t n, const std::vector<int>& keys) {
+	Pq<int, 4, int, std::greater<int>, std::allocator<int>, Stats> q;
+	for (std::size_t i = 0; i < n; i++) {
+		q.enqueue(i, keys[i]);
+	}
+
+	std::size_t ops = keys.size() - n;
+	long long sum = 0;
+	auto start = bench::Clock::now();
+	for (std::size_t i = n; i < keys.size(); i++) {
+		sum += q.dequeue();
+		q.enqueue(i, keys[i]);
+	}
+	bench::report(std::string("hold Pq<4> ") + name, n, ops, bench::nsSince(start));
+	bench::doNotOptimize(sum);
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 20);
+
+	const bench::Distribution dists[] = {
+		bench::Distribution::RANDOM,
+		bench::Distribution::SORTED,
+		bench::Distribution::REVERSE,
+		bench::Distribution::DUPLICATES,
+	};
+	for (bench::Distribution dist : dists) {
+		counts<2>(n, dist);
+		counts<4>(n, dist);
+		counts<8>(n, dist);
+	}
+
+	std::vector<int> keys = bench::randomKeys(n + 4 * n, 73);
+	overhead<NoStats>("NoStats", n, keys);
+	overhead<CountingStats>("CountingStats", n, keys);
+	overhead<ProfilingStats>("ProfilingStats", n, keys);
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <harness.hh>
+#include <pq.hh>
+#include <top_k.hh>
+
+/*
+ * Keeping the k highest keys of a stream of n. TopK is compared with a
+ * bounded std::priority_queue driven by hand (min heap, top/pop/push),
+ * with growing a Pq over the whole stream and popping k, and with
+ * nth_element over a copy as the offline reference. Random streams
+ * reject almost everything once the set is full. Sorted ascending
+ * streams make every item qualify, which is the worst case. The last
+ * rows time mergeFrom folding 8 partial sets together.
+ * Usage: bench_top_k [n]
+ */
+
+typedef std::pair<int, int> Entry;
+
+long long runTopK(const std::vector<int>& keys, std::size_t k) {
+	TopK<int> top(k);
+	for (std::size_t i = 0; i < keys.size(); i++) {
+		top.offer(i, keys[i]);
+	}
+	return top.threshold();
+}
+
+long long runStdBounded(const std::vector<int>& keys, std::size_t k) {
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > q;
+	for (std::size_t i = 0; i < keys.size(); i++) {
+		if (q.size() < k) {
+			q.emplace(keys[i], i);
+		} else if (keys[i] > q.top().first) {
+			q.pop();
+			q.emplace(keys[i], i);
+		}
+	}
+	return q.top().first;
+}
+
+long long runGrowAll(const std::vector<int>& keys, std::size_t k) {
+	Pq<int, 4> q;
+	for (std::size_t i = 0; i < keys.size(); i++) {
+		q.enqueue(i, keys[i]);
+	}
+	std::vector<int> out(k);
+	q.dequeueBatch(k, out.begin());
+	return out[k - 1];
+}
+
+long long runNthElement(const std::vector<int>& keys, std::size_t k) {
+	std::vector<int> copy(keys);
+	std::nth_element(copy.begin(), copy.begin() + (k - 1), copy.end(), std::greater<int>());
+	return copy[k - 1];
+}
+
+void timeRun(const std::string& name, long long (*run)(const std::vector<int>&, std::size_t),
+	const std::vector<int>& keys, std::size_t k) {
+	auto start = bench::Clock::now();
+	long long result = run(keys, k);
+	bench::report(name, keys.size(), keys.size(), bench::nsSince(start));
+	bench::doNotOptimize(result);
+}
+
+void timeMerge(const std::vector<int>& keys, std::size_t k) {
+	const std::size_t parts = 8;
+	std::vector<TopK<int> > sets;
+	for (std::size_t p = 0; p < parts; p++) {
+		sets.emplace_back(k);
+	}
+	for (std::size_t i = 0; i < keys.size(); i++) {
+		sets[i % parts].offer(i, keys[i]);
+	}
+
+	auto start = bench::Clock::now();
+	for (std::size_t p = 1; p < parts; p++) {
+		sets[0].mergeFrom(std::move(sets[p]));
+	}
+	bench::report("mergeFrom x" + std::to_string(parts) + " k=" + std::to_string(k),
+		keys.size(), (parts - 1) * k, bench::nsSince(start));
+	bench::doNotOptimize(sets[0].threshold());
+}
+
+int main(int argc, char** argv) {
+	argc = bench::parseFormat(argc, argv);
+	std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 24);
+
+	const bench::Distribution dists[] = {
+		bench::Distribution::RANDOM,
+		bench::Distribution::SORTED,
+	};
+	for (bench::Distribution dist : dists) {
+		std::vector<int> keys = bench::makeKeys(dist, n, 61);
+		std::string suffix = std::string("/") + bench::distributionName(dist);
+		for (std::size_t k = 10; k <= 10000 && k <= n; k *= 10) {
+			std::string label = " k=" + std::to_string(k) + suffix;
+			timeRun("TopK" + label, runTopK, keys, k);
+			timeRun("std::priority_queue bounded" + label, runStdBounded, keys, k);
+			timeRun("Pq grow all + dequeueBatch" + label, runGrowAll, keys, k);
+			timeRun("nth_element copy" + label, runNthElement, keys, k);
+		}
+	}
+
+	std::vector<int> keys = bench::randomKeys(n, 67);
+	for (std::size_t k = 10; k <= 10000 && k <= n; k *= 10) {
+		timeMerge(keys, k);
+	}
+	return 0;
+}
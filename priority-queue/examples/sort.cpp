@@ -1,19 +1,55 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include <string>
-#include <pq.hh>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pq_sort.hh>
+
+/*
+ * Without arguments this asks for one number per prompt until Q and
+ * prints them largest first. With a path, or - for stdin, it runs in
+ * batch mode instead:
+ *
+ * - a regular file is mapped whole, a pipe is read in 4 MiB blocks
+ * - integers are separated by whitespace or commas and parsed eight
+ *   digits at a time from one 64 bit load
+ * - the numbers are sorted largest first with pqSort on every core
+ * - output goes through one 4 MiB buffer, one number per line
+ *
+ * Tokens that are not ints are skipped and counted. Timings per phase go
+ * to stderr so stdout stays just the numbers.
+ * Usage: sort [path|-]
+ *
+ * tests/sort_batch.cpp includes this file with SORT_NO_MAIN defined.
+ */
+
+typedef std::chrono::steady_clock Clock;
+
+const std::size_t IO_BLOCK = 4 << 20;
 
 bool tryParse(std::string& input, int& output) {
 	try {
 		output = std::stoi(input);
 		return true;
-	} catch (std::invalid_argument) {
+	} catch (const std::invalid_argument&) {
 		return false;
 	}
 }
 
-int main() {
-	Pq<int> pq;
+int runInteractive() {
+	std::vector<int> nums;
 
 	std::string input;
 	int x;
@@ -36,20 +72,279 @@ int main() {
 			}
 		}
 
-		pq.enqueue(x, x);	
+		nums.push_back(x);
 	}
 
 	std::cout << "Printing Unsorted List from num inputs " << std::endl;
-	
-	pq.print();
-	
-	std::cout << "Printing Sorted List from num inputs " << pq.count() << std::endl;
 
-	while (!pq.isEmpty()) {
-		std::cout << pq.dequeue() << std::endl;
-	}
-	
+	std::copy(nums.begin(), nums.end(), std::ostream_iterator<int>(std::cout, "\n"));
+
+	// largest first, runs are heapsorted on every core and merged by a LoserTree
+	pqSort(nums.begin(), nums.end(), std::thread::hardware_concurrency(), std::greater<int>());
+
+	std::cout << "Printing Sorted List from num inputs " << nums.size() << std::endl;
+
+	std::copy(nums.begin(), nums.end(), std::ostream_iterator<int>(std::cout, "\n"));
+
 	std::cout << "-- Done --" << std::endl;
 
 	return 0;
 }
+
+inline bool isSeparator(unsigned char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == ',';
+}
+
+// number of leading ASCII digits in the 8 bytes of chunk, first byte lowest
+inline unsigned leadingDigits(std::uint64_t chunk) {
+	// a byte below '0' sets its top bit in x, one above '9' in x + 0x76. Bytes
+	// after the first non-digit may be garbled by borrows, which is harmless.
+	std::uint64_t x = chunk - 0x3030303030303030ULL;
+	std::uint64_t nonDigit = (x | (x + 0x7676767676767676ULL)) & 0x8080808080808080ULL;
+	return nonDigit == 0 ? 8 : __builtin_ctzll(nonDigit) / 8;
+}
+
+// value of the first len (1 to 8) digits of chunk, pairwise then in quads
+inline std::uint64_t digitsValue(std::uint64_t chunk, unsigned len) {
+	std::uint64_t val = (chunk - 0x3030303030303030ULL) << (8 * (8 - len));
+	val = (val * 10) + (val >> 8);
+	return (((val & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+		(((val >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+}
+
+/*
+ * Appends the ints in [p, end) to out and counts malformed tokens in bad.
+ * Unless final, a token that runs into end may continue in the next
+ * block, so parsing stops at its start and that is returned.
+ */
+const char* parseInts(const char* p, const char* end, bool final, std::vector<int>& out,
+	std::size_t& bad) {
+	static const std::uint64_t POW10[9] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	};
+
+	while (p < end) {
+		if (isSeparator(*p)) {
+			p++;
+			continue;
+		}
+
+		const char* start = p;
+		bool negative = *p == '-';
+		p += negative;
+
+		std::uint64_t value = 0;
+		unsigned digits = 0;
+		if (end - p >= 16) {
+			std::uint64_t chunk;
+			std::memcpy(&chunk, p, 8);
+			digits = leadingDigits(chunk);
+			if (digits > 0) {
+				value = digitsValue(chunk, digits);
+				p += digits;
+			}
+			if (digits == 8) {
+				std::memcpy(&chunk, p, 8);
+				unsigned more = leadingDigits(chunk);
+				if (more > 0) {
+					value = value * POW10[more] + digitsValue(chunk, more);
+					digits += more;
+					p += more;
+				}
+			}
+		} else {
+			while (p < end && static_cast<unsigned char>(*p - '0') < 10 && digits < 19) {
+				value = value * 10 + (*p - '0');
+				digits++;
+				p++;
+			}
+		}
+
+		if (p == end && !final) {
+			return start;
+		}
+		std::uint64_t limit = negative ? 2147483648ULL : 2147483647ULL;
+		if (digits == 0 || digits > 10 || value > limit || (p < end && !isSeparator(*p))) {
+			while (p < end && !isSeparator(*p)) {
+				p++;
+			}
+			if (p == end && !final) {
+				return start;
+			}
+			bad++;
+			continue;
+		}
+		out.push_back(negative ? static_cast<int>(0 - value) : static_cast<int>(value));
+	}
+	return p;
+}
+
+void writeAll(int fd, const char* data, std::size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+// ints one per line into a fixed buffer that is written out whenever it fills
+class LineWriter {
+	public:
+		explicit LineWriter(int fd) : fd(fd), buf(IO_BLOCK), used(0) {}
+
+		void put(int v) {
+			// "-2147483648\n" is the longest line
+			if (this->buf.size() - this->used < 12) {
+				this->flush();
+			}
+			static const char PAIRS[] =
+				"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+				"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+				"8081828384858687888990919293949596979899";
+			char tmp[12];
+			char* q = tmp + sizeof(tmp);
+			*--q = '\n';
+			std::uint32_t u = v < 0 ? 0u - static_cast<std::uint32_t>(v) : v;
+			while (u >= 100) {
+				q -= 2;
+				std::memcpy(q, PAIRS + (u % 100) * 2, 2);
+				u /= 100;
+			}
+			if (u >= 10) {
+				q -= 2;
+				std::memcpy(q, PAIRS + u * 2, 2);
+			} else {
+				*--q = static_cast<char>('0' + u);
+			}
+			if (v < 0) {
+				*--q = '-';
+			}
+			std::size_t len = tmp + sizeof(tmp) - q;
+			std::memcpy(&this->buf[this->used], q, len);
+			this->used += len;
+		}
+
+		void flush() {
+			writeAll(this->fd, this->buf.data(), this->used);
+			this->used = 0;
+		}
+	private:
+		int fd;
+		std::vector<char> buf;
+		std::size_t used;
+};
+
+double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void reportPhase(const char* name, double ms, std::size_t bytes) {
+	std::fprintf(stderr, "  %-6s %10.1f ms %10.1f MB/s\n", name, ms, bytes / 1e3 / ms);
+}
+
+int runBatch(const char* path) {
+	int fd = std::strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+	if (fd < 0) {
+		std::fprintf(stderr, "sort: %s: %s\n", path, std::strerror(errno));
+		return 1;
+	}
+	// closes the file on every way out, stdin is left alone
+	struct FileCloser {
+		int fd;
+		~FileCloser() {
+			if (this->fd != STDIN_FILENO) {
+				close(this->fd);
+			}
+		}
+	} closer{fd};
+
+	std::vector<int> nums;
+	std::size_t bad = 0;
+	std::size_t inBytes = 0;
+	auto start = Clock::now();
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		inBytes = st.st_size;
+		void* map = mmap(nullptr, inBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			std::fprintf(stderr, "sort: mmap %s: %s\n", path, std::strerror(errno));
+			return 1;
+		}
+		madvise(map, inBytes, MADV_SEQUENTIAL);
+		// a line per int is rarely shorter than 8 bytes, so this seldom regrows
+		nums.reserve(inBytes / 8);
+		const char* text = static_cast<const char*>(map);
+		parseInts(text, text + inBytes, true, nums, bad);
+		munmap(map, inBytes);
+	} else {
+		// a partial token at the end of a block is moved to the front for the next read
+		std::vector<char> buf(IO_BLOCK);
+		std::size_t carried = 0;
+		while (true) {
+			if (carried == buf.size()) {
+				buf.resize(buf.size() * 2);
+			}
+			ssize_t n = read(fd, buf.data() + carried, buf.size() - carried);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n < 0) {
+				std::fprintf(stderr, "sort: read %s: %s\n", path, std::strerror(errno));
+				return 1;
+			}
+			inBytes += n;
+			bool final = n == 0;
+			const char* end = buf.data() + carried + n;
+			const char* stop = parseInts(buf.data(), end, final, nums, bad);
+			if (final) {
+				break;
+			}
+			carried = end - stop;
+			std::memmove(buf.data(), stop, carried);
+		}
+	}
+	double parseMs = msSince(start);
+
+	start = Clock::now();
+	pqSort(nums.begin(), nums.end(), std::thread::hardware_concurrency(), std::greater<int>());
+	double sortMs = msSince(start);
+
+	start = Clock::now();
+	LineWriter out(STDOUT_FILENO);
+	for (int v : nums) {
+		out.put(v);
+	}
+	out.flush();
+	double writeMs = msSince(start);
+
+	std::fprintf(stderr, "sort: %zu bytes, %zu ints, %zu bad tokens\n", inBytes, nums.size(), bad);
+	reportPhase("parse", parseMs, inBytes);
+	reportPhase("sort", sortMs, inBytes);
+	reportPhase("write", writeMs, inBytes);
+	return 0;
+}
+
+#ifndef SORT_NO_MAIN
+int main(int argc, char** argv) {
+	if (argc > 2) {
+		std::fprintf(stderr, "usage: %s [path|-]\n", argv[0]);
+		return 2;
+	}
+	if (argc == 1) {
+		return runInteractive();
+	}
+	try {
+		return runBatch(argv[1]);
+	} catch (const std::exception& e) {
+		std::fprintf(stderr, "sort: %s\n", e.what());
+		return 1;
+	}
+}
+#endif
@@ -0,0 +1,362 @@
+#ifndef EXECUTOR_H
+
+#define EXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <pq.hh>
+#include <pq_stats.hh>
+
+/*
+ * Executor runs tasks on a fixed pool of worker threads in priority
+ * order. A task is submitted with a priority class, 0 being the lowest,
+ * and optionally a deadline.
+ *
+ * - Every worker owns a Pq of tasks behind its own mutex. A task
+ *   submitted from a worker goes into that worker's queue, tasks from
+ *   other threads are dealt round robin.
+ * - Each queue publishes the class of its top task through an atomic.
+ *   A worker looking for work reads all of them and takes the top of the
+ *   queue with the highest class, its own on a tie. So a worker steals
+ *   when it runs dry, and also whenever another queue holds more urgent
+ *   work than its own. Priority holds across the pool, not just per
+ *   queue.
+ * - Within a class, tasks with a deadline run earliest deadline first,
+ *   ahead of tasks without one, which run in submission order. A task
+ *   whose deadline has passed when a worker takes it is dropped and
+ *   counted as expired.
+ * - Idle workers sleep on a condition variable. Submitting wakes one of
+ *   them only when someone is asleep, so a busy pool pays no syscalls.
+ *
+ * Per class, stats() reports the queueing delay (submit to start) and
+ * the run time of every task as LatencyHistograms. A task that throws is
+ * counted as failed and the worker carries on.
+ *
+ * The destructor and shutdown() stop accepting tasks, run everything
+ * already queued and join the workers.
+ */
+
+struct ExecutorClassStats {
+	std::uint64_t completed;
+	std::uint64_t expired;
+	std::uint64_t failed;
+	LatencyHistogram queueDelay;
+	LatencyHistogram runTime;
+};
+
+class Executor {
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		explicit Executor(std::size_t workers = std::thread::hardware_concurrency(),
+			std::size_t classes = 4);
+		~Executor();
+
+		Executor(const Executor&) = delete;
+		Executor& operator=(const Executor&) = delete;
+
+		// throws std::invalid_argument for a class out of range, std::runtime_error after shutdown
+		void submit(std::size_t priorityClass, std::function<void()> task);
+		void submit(std::size_t priorityClass, Clock::time_point deadline, std::function<void()> task);
+		// blocks until every submitted task has finished or expired
+		void waitIdle();
+		void shutdown();
+		// one entry per class
+		std::vector<ExecutorClassStats> stats() const;
+		void resetStats();
+		std::size_t workerCount() const;
+		std::size_t classCount() const;
+	private:
+		// higher class first, then earlier deadline, then submission order
+		struct TaskKey {
+			std::uint32_t priorityClass;
+			std::int64_t deadline;
+			std::uint64_t seq;
+		};
+
+		struct TaskOrder {
+			bool operator()(const TaskKey& a, const TaskKey& b) const {
+				if (a.priorityClass != b.priorityClass) {
+					return a.priorityClass > b.priorityClass;
+				}
+				if (a.deadline != b.deadline) {
+					return a.deadline < b.deadline;
+				}
+				return a.seq < b.seq;
+			}
+		};
+
+		struct Task {
+			std::function<void()> fn;
+			Clock::time_point submitted;
+		};
+
+		static constexpr int EMPTY = -1;
+		static constexpr std::int64_t NO_DEADLINE = INT64_MAX;
+
+		struct alignas(64) Worker {
+			std::mutex lock;
+			Pq<Task, 4, TaskKey, TaskOrder> queue;
+			// class of the queue's top task, EMPTY when it has none
+			std::atomic<int> top{EMPTY};
+			// written by the worker under statsLock, read by stats()
+			mutable std::mutex statsLock;
+			std::vector<ExecutorClassStats> stats;
+			std::thread thread;
+		};
+
+		std::size_t numClasses;
+		std::unique_ptr<Worker[]> workers;
+		std::size_t numWorkers;
+		std::atomic<std::uint64_t> nextSeq{0};
+		std::atomic<std::size_t> nextWorker{0};
+
+		// tasks sitting in queues, and tasks not finished yet
+		std::atomic<std::size_t> queued{0};
+		std::atomic<std::size_t> unfinished{0};
+		std::atomic<std::size_t> sleeping{0};
+		std::atomic<bool> stopping{false};
+		std::mutex sleepLock;
+		std::condition_variable wake;
+		std::mutex idleLock;
+		std::condition_variable idle;
+
+		static Executor*& currentExecutor();
+		static std::size_t& currentWorker();
+		void push(std::size_t priorityClass, std::int64_t deadline, std::function<void()>&& task);
+		static void publish(Worker& w);
+		bool take(std::size_t self, Task& task, TaskKey& key);
+		void run(std::size_t self, Task& task, const TaskKey& key);
+		void workerLoop(std::size_t self);
+};
+
+inline Executor::Executor(std::size_t workers, std::size_t classes)
+	: numClasses(classes == 0 ? 1 : classes), workers(new Worker[workers == 0 ? 1 : workers]),
+	numWorkers(workers == 0 ? 1 : workers) {
+	for (std::size_t i = 0; i < this->numWorkers; i++) {
+		this->workers[i].stats.assign(this->numClasses, ExecutorClassStats());
+	}
+	for (std::size_t i = 0; i < this->numWorkers; i++) {
+		this->workers[i].thread = std::thread(&Executor::workerLoop, this, i);
+	}
+}
+
+inline Executor::~Executor() {
+	this->shutdown();
+}
+
+// which executor and worker the calling thread belongs to, if any
+inline Executor*& Executor::currentExecutor() {
+	static thread_local Executor* executor = nullptr;
+	return executor;
+}
+
+inline std::size_t& Executor::currentWorker() {
+	static thread_local std::size_t worker = 0;
+	return worker;
+}
+
+inline void Executor::submit(std::size_t priorityClass, std::function<void()> task) {
+	this->push(priorityClass, NO_DEADLINE, std::move(task));
+}
+
+inline void Executor::submit(std::size_t priorityClass, Clock::time_point deadline,
+	std::function<void()> task) {
+	this->push(priorityClass, deadline.time_since_epoch().count(), std::move(task));
+}
+
+inline void Executor::push(std::size_t priorityClass, std::int64_t deadline,
+	std::function<void()>&& task) {
+	if (priorityClass >= this->numClasses) {
+		throw std::invalid_argument("Executor priority class out of range");
+	}
+	// counted before the stopping check, so a worker never exits with this task on the way
+	this->queued.fetch_add(1);
+	if (this->stopping.load()) {
+		this->queued.fetch_sub(1);
+		throw std::runtime_error("Executor is shut down");
+	}
+
+	std::size_t target = currentExecutor() == this ? currentWorker()
+		: this->nextWorker.fetch_add(1, std::memory_order_relaxed) % this->numWorkers;
+	TaskKey key{static_cast<std::uint32_t>(priorityClass), deadline,
+		this->nextSeq.fetch_add(1, std::memory_order_relaxed)};
+
+	this->unfinished.fetch_add(1);
+	Worker& w = this->workers[target];
+	{
+		std::lock_guard<std::mutex> guard(w.lock);
+		w.queue.enqueue(Task{std::move(task), Clock::now()}, key);
+		publish(w);
+	}
+
+	// a sleeper bumps sleeping before it checks queued, so one of the two sides sees the other
+	if (this->sleeping.load() > 0) {
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		this->wake.notify_one();
+	}
+}
+
+// called with w.lock held
+inline void Executor::publish(Worker& w) {
+	int top = w.queue.isEmpty() ? EMPTY : static_cast<int>(w.queue.peekKey().priorityClass);
+	w.top.store(top, std::memory_order_relaxed);
+}
+
+inline bool Executor::take(std::size_t self, Task& task, TaskKey& key) {
+	for (std::size_t attempt = 0; attempt < 2 * this->numWorkers; attempt++) {
+		std::size_t best = self;
+		int bestTop = this->workers[self].top.load(std::memory_order_relaxed);
+		for (std::size_t i = 1; i < this->numWorkers; i++) {
+			std::size_t victim = (self + i) % this->numWorkers;
+			int top = this->workers[victim].top.load(std::memory_order_relaxed);
+			if (top > bestTop) {
+				best = victim;
+				bestTop = top;
+			}
+		}
+		if (bestTop == EMPTY) {
+			return false;
+		}
+
+		Worker& w = this->workers[best];
+		std::lock_guard<std::mutex> guard(w.lock);
+		if (w.queue.isEmpty()) {
+			// raced with another taker, look again
+			continue;
+		}
+		key = w.queue.peekKey();
+		task = w.queue.dequeue();
+		publish(w);
+		this->queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+inline void Executor::run(std::size_t self, Task& task, const TaskKey& key) {
+	Clock::time_point start = Clock::now();
+	bool expired = key.deadline != NO_DEADLINE && start.time_since_epoch().count() > key.deadline;
+	bool failed = false;
+	if (!expired) {
+		try {
+			task.fn();
+		} catch (...) {
+			failed = true;
+		}
+	}
+	Clock::time_point end = Clock::now();
+
+	Worker& w = this->workers[self];
+	{
+		std::lock_guard<std::mutex> guard(w.statsLock);
+		ExecutorClassStats& s = w.stats[key.priorityClass];
+		if (expired) {
+			s.expired++;
+		} else {
+			s.completed += !failed;
+			s.failed += failed;
+			s.queueDelay.record(std::chrono::nanoseconds(start - task.submitted).count());
+			s.runTime.record(std::chrono::nanoseconds(end - start).count());
+		}
+	}
+	// drop captures before anyone waiting on idle can look
+	task.fn = nullptr;
+
+	if (this->unfinished.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> guard(this->idleLock);
+		this->idle.notify_all();
+	}
+}
+
+inline void Executor::workerLoop(std::size_t self) {
+	currentExecutor() = this;
+	currentWorker() = self;
+
+	Task task;
+	TaskKey key;
+	while (true) {
+		if (this->take(self, task, key)) {
+			this->run(self, task, key);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(this->sleepLock);
+		this->sleeping.fetch_add(1);
+		while (this->queued.load() == 0 && !this->stopping.load()) {
+			this->wake.wait(guard);
+		}
+		this->sleeping.fetch_sub(1);
+		// stopping first: push() counts a task in queued before it reads stopping,
+		// so once stopping is seen set, every task push() accepted shows in queued
+		bool stop = this->stopping.load();
+		if (stop && this->queued.load() == 0) {
+			return;
+		}
+	}
+}
+
+inline void Executor::waitIdle() {
+	std::unique_lock<std::mutex> guard(this->idleLock);
+	this->idle.wait(guard, [this]() {
+		return this->unfinished.load() == 0;
+	});
+}
+
+inline void Executor::shutdown() {
+	{
+		std::lock_guard<std::mutex> guard(this->sleepLock);
+		if (this->stopping.exchange(true)) {
+			return;
+		}
+		this->wake.notify_all();
+	}
+	for (std::size_t i = 0; i < this->numWorkers; i++) {
+		if (this->workers[i].thread.joinable()) {
+			this->workers[i].thread.join();
+		}
+	}
+}
+
+inline std::vector<ExecutorClassStats> Executor::stats() const {
+	std::vector<ExecutorClassStats> total(this->numClasses, ExecutorClassStats());
+	for (std::size_t i = 0; i < this->numWorkers; i++) {
+		std::lock_guard<std::mutex> guard(this->workers[i].statsLock);
+		for (std::size_t c = 0; c < this->numClasses; c++) {
+			const ExecutorClassStats& s = this->workers[i].stats[c];
+			ExecutorClassStats& t = total[c];
+			t.completed += s.completed;
+			t.expired += s.expired;
+			t.failed += s.failed;
+			t.queueDelay.merge(s.queueDelay);
+			t.runTime.merge(s.runTime);
+		}
+	}
+	return total;
+}
+
+inline void Executor::resetStats() {
+	for (std::size_t i = 0; i < this->numWorkers; i++) {
+		std::lock_guard<std::mutex> guard(this->workers[i].statsLock);
+		this->workers[i].stats.assign(this->numClasses, ExecutorClassStats());
+	}
+}
+
+inline std::size_t Executor::workerCount() const {
+	return this->numWorkers;
+}
+
+inline std::size_t Executor::classCount() const {
+	return this->numClasses;
+}
+
+#endif
@@ -0,0 +1,560 @@
+#ifndef EXTERNAL_PQ_H
+
+#define EXTERNAL_PQ_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pq.hh>
+
+/*
+ * ExternalPq is a priority queue for more items than fit in memory, in
+ * the style of Sanders' sequence heap. It keeps three things in RAM:
+ *
+ * - a bounded Pq that takes every enqueue (the insertion buffer)
+ * - one read window per sorted run on disk
+ * - a small Pq over the head of every run
+ *
+ * When the insertion buffer is full it is drained in order into a new run,
+ * an unlinked temp file, so nothing is left behind if the process dies.
+ * dequeue takes the better of the buffer top and the best run head. Runs
+ * are read sequentially through mmap windows. The next window is announced
+ * to the kernel with fadvise(WILLNEED) so it is already being read while
+ * the current one is consumed, and consumed windows are dropped from the
+ * page cache.
+ *
+ * The fan-in (how many runs can be open at once) is what the budget leaves
+ * after the buffer. When one more run would not fit, the smaller half of
+ * the runs are merged into one, so an item is rewritten about
+ * log(spills) / log(fan-in) times, like the levels of a sequence heap.
+ *
+ * memoryBudget caps the buffer, the windows and the write buffer together.
+ * Half goes to the insertion buffer, and windows are budget / 64 clamped
+ * to 64 KiB .. 8 MiB. The budget must leave room for at least two windows,
+ * otherwise the constructor throws std::invalid_argument.
+ *
+ * T and Key are written to disk byte for byte, so both must be trivially
+ * copyable. File errors throw std::system_error. A spill that fails puts
+ * its items back in the insertion buffer, so the queue stays whole. Items
+ * being merged when an error hits are lost, so after a failed merge the
+ * queue should be dropped.
+ */
+
+/*
+ * Sequential reader over one sorted run. Only the current window is
+ * mapped, and head() is a copy so it stays valid across remaps.
+ */
+template<typename Record>
+class SpillRun {
+	public:
+		// owns fd once constructed, if the constructor throws fd is still the caller's
+		SpillRun(int fd, std::uint64_t records, std::size_t windowBytes);
+		~SpillRun();
+
+		SpillRun(const SpillRun&) = delete;
+		SpillRun& operator=(const SpillRun&) = delete;
+
+		const Record& head() const;
+		// moves to the next record, false once the run is used up. If
+		// mapping the next window throws, the run stays where it was.
+		bool advance();
+		std::uint64_t remaining() const;
+	private:
+		int fd;
+		std::uint64_t total;
+		std::uint64_t next = 0;
+		std::size_t window;
+		char* map = nullptr;
+		std::uint64_t mapOffset = 0;
+		std::size_t mapLength = 0;
+		// first record index past the mapped window
+		std::uint64_t mapEnd = 0;
+		Record current;
+
+		void remap();
+		void load();
+};
+
+template<typename Record>
+SpillRun<Record>::SpillRun(int fd, std::uint64_t records, std::size_t windowBytes)
+	: fd(fd), total(records), window(windowBytes) {
+	if (this->total > 0) {
+		this->remap();
+		this->load();
+	}
+}
+
+template<typename Record>
+SpillRun<Record>::~SpillRun() {
+	if (this->map) {
+		munmap(this->map, this->mapLength);
+	}
+	close(this->fd);
+}
+
+template<typename Record>
+void SpillRun<Record>::remap() {
+	if (this->map) {
+		munmap(this->map, this->mapLength);
+		// consumed, no reason to keep it in the page cache
+		posix_fadvise(this->fd, this->mapOffset, this->mapLength, POSIX_FADV_DONTNEED);
+		this->map = nullptr;
+	}
+
+	std::uint64_t page = sysconf(_SC_PAGESIZE);
+	std::uint64_t fileBytes = this->total * sizeof(Record);
+	std::uint64_t offset = (this->next * sizeof(Record)) & ~(page - 1);
+	std::uint64_t end = offset + this->window < fileBytes ? offset + this->window : fileBytes;
+
+	void* p = mmap(nullptr, end - offset, PROT_READ, MAP_PRIVATE, this->fd, offset);
+	if (p == MAP_FAILED) {
+		throw std::system_error(errno, std::generic_category(), "mapping spill file");
+	}
+	this->map = static_cast<char*>(p);
+	this->mapOffset = offset;
+	this->mapLength = end - offset;
+	this->mapEnd = end / sizeof(Record);
+
+	madvise(this->map, this->mapLength, MADV_SEQUENTIAL);
+	madvise(this->map, this->mapLength, MADV_WILLNEED);
+	// start reading the following window while this one is consumed
+	if (end < fileBytes) {
+		posix_fadvise(this->fd, end, this->window, POSIX_FADV_WILLNEED);
+	}
+}
+
+template<typename Record>
+void SpillRun<Record>::load() {
+	std::memcpy(&this->current,
+		this->map + (this->next * sizeof(Record) - this->mapOffset), sizeof(Record));
+}
+
+template<typename Record>
+const Record& SpillRun<Record>::head() const {
+	return this->current;
+}
+
+template<typename Record>
+bool SpillRun<Record>::advance() {
+	this->next++;
+	if (this->next == this->total) {
+		return false;
+	}
+	if (this->next >= this->mapEnd) {
+		try {
+			this->remap();
+		} catch (...) {
+			// head() is a copy, so it is still the current record
+			this->next--;
+			throw;
+		}
+	}
+	this->load();
+	return true;
+}
+
+template<typename Record>
+std::uint64_t SpillRun<Record>::remaining() const {
+	return this->total - this->next;
+}
+
+template<typename T, typename Key = int, typename Compare = std::greater<Key> >
+class ExternalPq {
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_copyable<Key>::value,
+		"spilled items are written to disk byte for byte");
+
+	public:
+		explicit ExternalPq(std::size_t memoryBudget,
+			const std::string& tempDir = defaultTempDir(), const Compare& comp = Compare());
+
+		ExternalPq(const ExternalPq&) = delete;
+		ExternalPq& operator=(const ExternalPq&) = delete;
+
+		void enqueue(const T& item, Key priority);
+		// throws std::out_of_range when empty
+		T dequeue();
+		std::optional<T> tryDequeue();
+		// the reference is good until the next enqueue or dequeue
+		const T& peek() const;
+		Key peekKey() const;
+		// size_t rather than Pq's int, the point is holding billions
+		std::size_t count() const;
+		bool isEmpty() const;
+		// sorted runs currently on disk
+		std::size_t runCount() const;
+		// bytes written to temp files so far, merges included
+		std::uint64_t bytesSpilled() const;
+
+		// $TMPDIR, or /tmp when unset
+		static std::string defaultTempDir();
+	private:
+		struct Record {
+			Key key;
+			T val;
+		};
+
+		typedef SpillRun<Record> Run;
+		typedef Pq<std::size_t, 4, Key, Compare> HeadPq;
+
+		Compare comp;
+		std::string dir;
+		std::size_t window;
+		std::size_t bufferCap;
+		std::size_t fanIn;
+		Pq<T, 4, Key, Compare> buffer;
+		// a null slot is a finished run, slots are reused
+		std::vector<std::unique_ptr<Run> > runs;
+		std::size_t activeRuns = 0;
+		// run slot keyed by the key of its head record
+		HeadPq heads;
+		std::vector<Record> out;
+		std::size_t size = 0;
+		std::uint64_t spilled = 0;
+
+		// creates and immediately unlinks a temp file in dir, returns its fd
+		static int openSpillFile(const std::string& dir);
+		static void writeAll(int fd, const void* data, std::size_t size);
+		bool fromBuffer() const;
+		void spill();
+		void compact();
+		void emit(int fd, const Record& record);
+		void flush(int fd);
+		// takes fd over, it is closed even when this throws
+		void addRun(int fd, std::uint64_t records);
+		// puts a failed spill's records back in the buffer
+		void unspill(int fd, std::uint64_t written);
+		void rebuildHeads();
+		T popRun();
+};
+
+template<typename T, typename Key, typename Compare>
+std::string ExternalPq<T, Key, Compare>::defaultTempDir() {
+	const char* env = std::getenv("TMPDIR");
+	return env && *env ? env : "/tmp";
+}
+
+template<typename T, typename Key, typename Compare>
+int ExternalPq<T, Key, Compare>::openSpillFile(const std::string& dir) {
+	std::string path = dir + "/pq-spill-XXXXXX";
+	std::vector<char> name(path.begin(), path.end());
+	name.push_back('\0');
+	int fd = mkstemp(name.data());
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "mkstemp in " + dir);
+	}
+	unlink(name.data());
+	return fd;
+}
+
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::writeAll(int fd, const void* data, std::size_t size) {
+	const char* p = static_cast<const char*>(data);
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "writing spill file");
+		}
+		p += n;
+		size -= n;
+	}
+}
+
+template<typename T, typename Key, typename Compare>
+ExternalPq<T, Key, Compare>::ExternalPq(std::size_t memoryBudget, const std::string& tempDir,
+	const Compare& comp)
+	: comp(comp), dir(tempDir), buffer(comp), heads(comp) {
+	std::size_t page = sysconf(_SC_PAGESIZE);
+	std::size_t w = memoryBudget / 64;
+	w = w < (64 << 10) ? (64 << 10) : w > (8 << 20) ? (8 << 20) : w;
+	// a window always has to cover a whole record past its page aligned start
+	if (w < page + 2 * sizeof(Record)) {
+		w = page + 2 * sizeof(Record);
+	}
+	this->window = (w + page - 1) & ~(page - 1);
+
+	std::size_t bufferBytes = memoryBudget / 2;
+	this->bufferCap = bufferBytes / (sizeof(Key) + sizeof(T));
+	std::size_t rest = memoryBudget - bufferBytes;
+	// one window's worth goes to the write buffer
+	this->fanIn = rest > this->window ? rest / this->window - 1 : 0;
+	if (this->bufferCap == 0 || this->fanIn < 2) {
+		throw std::invalid_argument("ExternalPq memory budget too small");
+	}
+
+	this->buffer.reserve(this->bufferCap);
+	this->out.reserve(this->window / sizeof(Record));
+}
+
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::enqueue(const T& item, Key priority) {
+	if (static_cast<std::size_t>(this->buffer.count()) == this->bufferCap) {
+		this->spill();
+	}
+	this->buffer.enqueue(item, priority);
+	this->size++;
+}
+
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::emit(int fd, const Record& record) {
+	this->out.push_back(record);
+	if (this->out.size() == this->out.capacity()) {
+		this->flush(fd);
+	}
+}
+
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::flush(int fd) {
+	writeAll(fd, this->out.data(), this->out.size() * sizeof(Record));
+	this->spilled += this->out.size() * sizeof(Record);
+	this->out.clear();
+}
+
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::addRun(int fd, std::uint64_t records) {
+	std::unique_ptr<Run> run;
+	try {
+		run.reset(new Run(fd, records, this->window));
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+
+	std::size_t slot = 0;
+	while (slot < this->runs.size() && this->runs[slot]) {
+		slot++;
+	}
+	if (slot == this->runs.size()) {
+		this->runs.emplace_back();
+	}
+	this->runs[slot] = std::move(run);
+	this->activeRuns++;
+	this->heads.enqueue(slot, this->runs[slot]->head().key);
+}
+
+// drain the whole buffer, best first, into a new run
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::spill() {
+	if (this->activeRuns == this->fanIn) {
+		this->compact();
+	}
+
+	int fd = openSpillFile(this->dir);
+	std::uint64_t records = 0;
+	try {
+		while (!this->buffer.isEmpty()) {
+			Key key = this->buffer.peekKey();
+			// counted first, a record is in out once emit is called even if it throws
+			records++;
+			this->emit(fd, Record{key, this->buffer.dequeue()});
+		}
+		this->flush(fd);
+	} catch (...) {
+		this->unspill(fd, records - this->out.size());
+		close(fd);
+		throw;
+	}
+	this->addRun(fd, records);
+}
+
+/*
+ * The first written records of a failed spill are in the file, the rest
+ * are still in out. Both go back into the buffer they came from, so there
+ * is room for them. Records that cannot be read back are dropped from
+ * size, so count() stays right.
+ */
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::unspill(int fd, std::uint64_t written) {
+	for (const Record& record : this->out) {
+		this->buffer.enqueue(record.val, record.key);
+	}
+
+	std::size_t chunk = this->out.capacity();
+	std::uint64_t restored = 0;
+	while (restored < written) {
+		std::size_t n = written - restored < chunk ? written - restored : chunk;
+		this->out.resize(n);
+		ssize_t got = pread(fd, this->out.data(), n * sizeof(Record), restored * sizeof(Record));
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			break;
+		}
+		n = got / sizeof(Record);
+		for (std::size_t i = 0; i < n; i++) {
+			this->buffer.enqueue(this->out[i].val, this->out[i].key);
+		}
+		restored += n;
+		if (n == 0) {
+			break;
+		}
+	}
+	this->out.clear();
+	this->size -= written - restored;
+}
+
+/*
+ * Merge the shorter half of the runs into one. Merging the shortest
+ * keeps long runs from being rewritten over and over, the same reason a
+ * sequence heap merges level by level.
+ */
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::compact() {
+	std::vector<std::pair<std::uint64_t, std::size_t> > bySize;
+	for (std::size_t slot = 0; slot < this->runs.size(); slot++) {
+		if (this->runs[slot]) {
+			bySize.emplace_back(this->runs[slot]->remaining(), slot);
+		}
+	}
+	std::size_t merging = (bySize.size() + 1) / 2;
+	merging = merging < 2 ? 2 : merging;
+	std::nth_element(bySize.begin(), bySize.begin() + (merging - 1), bySize.end());
+
+	HeadPq merge(this->comp);
+	for (std::size_t i = 0; i < merging; i++) {
+		std::size_t slot = bySize[i].second;
+		merge.enqueue(slot, this->runs[slot]->head().key);
+	}
+
+	int fd = openSpillFile(this->dir);
+	std::uint64_t records = 0;
+	try {
+		while (!merge.isEmpty()) {
+			std::size_t slot = merge.peek();
+			Run& run = *this->runs[slot];
+			this->emit(fd, run.head());
+			records++;
+			if (run.advance()) {
+				merge.replaceTop(slot, run.head().key);
+			} else {
+				merge.dequeue();
+			}
+		}
+		this->flush(fd);
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+
+	for (std::size_t i = 0; i < merging; i++) {
+		this->runs[bySize[i].second].reset();
+	}
+	this->activeRuns -= merging;
+	this->rebuildHeads();
+	this->addRun(fd, records);
+}
+
+template<typename T, typename Key, typename Compare>
+void ExternalPq<T, Key, Compare>::rebuildHeads() {
+	this->heads = HeadPq(this->comp);
+	for (std::size_t slot = 0; slot < this->runs.size(); slot++) {
+		if (this->runs[slot]) {
+			this->heads.enqueue(slot, this->runs[slot]->head().key);
+		}
+	}
+}
+
+// ties go to the buffer, it is cheaper to pop
+template<typename T, typename Key, typename Compare>
+bool ExternalPq<T, Key, Compare>::fromBuffer() const {
+	if (this->heads.isEmpty()) {
+		return true;
+	}
+	return !this->buffer.isEmpty() && !this->comp(this->heads.peekKey(), this->buffer.peekKey());
+}
+
+template<typename T, typename Key, typename Compare>
+T ExternalPq<T, Key, Compare>::popRun() {
+	std::size_t slot = this->heads.peek();
+	Run& run = *this->runs[slot];
+	T result = run.head().val;
+	if (run.advance()) {
+		this->heads.replaceTop(slot, run.head().key);
+	} else {
+		this->heads.dequeue();
+		this->runs[slot].reset();
+		this->activeRuns--;
+	}
+	return result;
+}
+
+template<typename T, typename Key, typename Compare>
+T ExternalPq<T, Key, Compare>::dequeue() {
+	if (this->size == 0) {
+		throw std::out_of_range("dequeue on empty ExternalPq");
+	}
+	// popRun can throw on disk errors, so count the item gone only once it is out
+	T result = this->fromBuffer() ? this->buffer.dequeue() : this->popRun();
+	this->size--;
+	return result;
+}
+
+template<typename T, typename Key, typename Compare>
+std::optional<T> ExternalPq<T, Key, Compare>::tryDequeue() {
+	if (this->size == 0) {
+		return std::nullopt;
+	}
+	return this->dequeue();
+}
+
+template<typename T, typename Key, typename Compare>
+const T& ExternalPq<T, Key, Compare>::peek() const {
+	if (this->size == 0) {
+		throw std::out_of_range("peek on empty ExternalPq");
+	}
+	if (this->fromBuffer()) {
+		return this->buffer.peek();
+	}
+	return this->runs[this->heads.peek()]->head().val;
+}
+
+template<typename T, typename Key, typename Compare>
+Key ExternalPq<T, Key, Compare>::peekKey() const {
+	if (this->size == 0) {
+		throw std::out_of_range("peekKey on empty ExternalPq");
+	}
+	if (this->fromBuffer()) {
+		return this->buffer.peekKey();
+	}
+	return this->heads.peekKey();
+}
+
+template<typename T, typename Key, typename Compare>
+std::size_t ExternalPq<T, Key, Compare>::count() const {
+	return this->size;
+}
+
+template<typename T, typename Key, typename Compare>
+bool ExternalPq<T, Key, Compare>::isEmpty() const {
+	return this->size == 0;
+}
+
+template<typename T, typename Key, typename Compare>
+std::size_t ExternalPq<T, Key, Compare>::runCount() const {
+	return this->activeRuns;
+}
+
+template<typename T, typename Key, typename Compare>
+std::uint64_t ExternalPq<T, Key, Compare>::bytesSpilled() const {
+	return this->spilled;
+}
+
+#endif
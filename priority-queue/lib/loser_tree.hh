@@ -0,0 +1,232 @@
+#ifndef LOSER_TREE_H
+
+#define LOSER_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * LoserTree merges K sorted input ranges into one sorted sequence. It is
+ * a tournament tree over the K range heads. Every inner node remembers
+ * the loser of the match played there and the overall winner sits above
+ * the root. Taking the winner advances its range and replays the matches
+ * on the path from that range's leaf up to the root only, against the
+ * stored losers:
+ *
+ * - about log2(K) comparisons per element, against up to 2 log_d(K)
+ *   for a d-ary Pq of heads, which compares siblings on every level
+ * - the path is fixed by the leaf, so there is no data dependent
+ *   branching on where to go next, and for integer heads the matches
+ *   themselves are branch free (they are coin tosses on random runs)
+ * - heads and source indices of the losers sit in two flat arrays like
+ *   Pq's keys and payloads, so a replay never chases an iterator
+ * - nothing is allocated after construction
+ *
+ * Compare is the output order: comp(a, b) is true when a comes out
+ * before b, so std::less merges ascending ranges. Any input iterator
+ * works, including std::istream_iterator for merging streams. Heads are
+ * held in the tree, so value_type has to be default constructible. Each
+ * element is read from its range once and moved from there on, so over
+ * std::make_move_iterator ranges nothing is copied at all. Like Pq,
+ * the merge is not stable: equal elements from different ranges come
+ * out in an unspecified order.
+ */
+template<typename InputIt,
+	typename Compare = std::less<typename std::iterator_traits<InputIt>::value_type> >
+class LoserTree {
+	public:
+		typedef typename std::iterator_traits<InputIt>::value_type value_type;
+		typedef std::pair<InputIt, InputIt> Range;
+
+		explicit LoserTree(const std::vector<Range>& ranges, const Compare& comp = Compare());
+
+		// next element, throws std::out_of_range when every range is exhausted
+		const value_type& peek() const;
+		// index into the constructor's ranges of the range peek() comes from
+		std::size_t peekSource() const;
+		value_type dequeue();
+		// writes up to k elements in order to out, returns how many were written
+		template<typename OutputIt>
+		std::size_t dequeueBatch(std::size_t k, OutputIt out);
+		// writes everything that is left, returns the advanced out
+		template<typename OutputIt>
+		OutputIt drainInto(OutputIt out);
+		std::size_t sourceCount() const;
+		bool isEmpty() const;
+	private:
+		// set in a tag once its source is exhausted, the head is stale from then on
+		static constexpr std::uint32_t DONE = std::uint32_t(1) << 31;
+
+		std::size_t k;
+		Compare comp;
+		// padded to a power of two with empty ranges
+		std::vector<Range> sources;
+		// slot 0 is the winner, slot i the loser of the match at inner node i.
+		// Kept apart like Pq's keys and vals so a replay stays in registers.
+		std::vector<value_type> heads;
+		std::vector<std::uint32_t> tags;
+
+		// an exhausted source loses to everything
+		bool beats(const value_type& a, std::uint32_t aTag, const value_type& b,
+			std::uint32_t bTag) const;
+		// advances the winner's range and replays its path
+		void advance();
+};
+
+template<typename InputIt, typename Compare>
+LoserTree<InputIt, Compare>::LoserTree(const std::vector<Range>& ranges, const Compare& comp)
+	: k(ranges.size()), comp(comp), sources(ranges) {
+	std::size_t leaves = 1;
+	while (leaves < this->k) {
+		leaves *= 2;
+	}
+	this->sources.resize(leaves, Range(InputIt(), InputIt()));
+
+	// play the first round bottom up, slot leaves + s of the scratch arrays is leaf s
+	std::vector<value_type> winHeads(2 * leaves);
+	std::vector<std::uint32_t> winTags(2 * leaves);
+	for (std::size_t s = 0; s < leaves; s++) {
+		bool done = s >= this->k || this->sources[s].first == this->sources[s].second;
+		winTags[leaves + s] = done ? s | DONE : s;
+		if (!done) {
+			winHeads[leaves + s] = *this->sources[s].first;
+		}
+	}
+	this->heads.resize(leaves);
+	this->tags.resize(leaves);
+	for (std::size_t node = leaves - 1; node > 0; node--) {
+		std::size_t win = 2 * node;
+		std::size_t lose = 2 * node + 1;
+		if (this->beats(winHeads[lose], winTags[lose], winHeads[win], winTags[win])) {
+			std::swap(win, lose);
+		}
+		winHeads[node] = std::move(winHeads[win]);
+		winTags[node] = winTags[win];
+		this->heads[node] = std::move(winHeads[lose]);
+		this->tags[node] = winTags[lose];
+	}
+	this->heads[0] = std::move(winHeads[1]);
+	this->tags[0] = winTags[1];
+}
+
+template<typename InputIt, typename Compare>
+bool LoserTree<InputIt, Compare>::beats(const value_type& a, std::uint32_t aTag,
+	const value_type& b, std::uint32_t bTag) const {
+	if ((aTag | bTag) & DONE) {
+		return !(aTag & DONE);
+	}
+	return this->comp(a, b);
+}
+
+template<typename InputIt, typename Compare>
+void LoserTree<InputIt, Compare>::advance() {
+	// heads[0] has been handed out already, only its slot is reused
+	std::uint32_t tag = this->tags[0];
+	value_type head = std::move(this->heads[0]);
+	Range& src = this->sources[tag];
+	++src.first;
+	if (src.first == src.second) {
+		tag |= DONE;
+	} else {
+		head = *src.first;
+	}
+
+	for (std::size_t node = (this->sources.size() + (tag & ~DONE)) / 2; node > 0; node /= 2) {
+		if constexpr (std::is_integral<value_type>::value && !std::is_same<value_type, bool>::value) {
+			// masks rather than ?:, which GCC turns back into a mispredicted jump here
+			typedef typename std::make_unsigned<value_type>::type Bits;
+			Bits other = this->heads[node];
+			std::uint32_t otherTag = this->tags[node];
+			Bits swap = ((otherTag & DONE) == 0) & (((tag & DONE) != 0) |
+				this->comp(static_cast<value_type>(other), head));
+			Bits diff = (other ^ static_cast<Bits>(head)) & (Bits(0) - swap);
+			std::uint32_t tagDiff = (otherTag ^ tag) & (0u - static_cast<std::uint32_t>(swap));
+			this->heads[node] = static_cast<value_type>(other ^ diff);
+			this->tags[node] = otherTag ^ tagDiff;
+			head = static_cast<value_type>(static_cast<Bits>(head) ^ diff);
+			tag ^= tagDiff;
+		} else if (this->beats(this->heads[node], this->tags[node], head, tag)) {
+			std::swap(this->heads[node], head);
+			std::swap(this->tags[node], tag);
+		}
+	}
+	this->heads[0] = std::move(head);
+	this->tags[0] = tag;
+}
+
+template<typename InputIt, typename Compare>
+const typename LoserTree<InputIt, Compare>::value_type& LoserTree<InputIt, Compare>::peek() const {
+	if (this->isEmpty()) {
+		throw std::out_of_range("LoserTree is empty");
+	}
+	return this->heads[0];
+}
+
+template<typename InputIt, typename Compare>
+std::size_t LoserTree<InputIt, Compare>::peekSource() const {
+	if (this->isEmpty()) {
+		throw std::out_of_range("LoserTree is empty");
+	}
+	return this->tags[0];
+}
+
+template<typename InputIt, typename Compare>
+typename LoserTree<InputIt, Compare>::value_type LoserTree<InputIt, Compare>::dequeue() {
+	if (this->isEmpty()) {
+		throw std::out_of_range("LoserTree is empty");
+	}
+	value_type out = std::move(this->heads[0]);
+	this->advance();
+	return out;
+}
+
+template<typename InputIt, typename Compare>
+template<typename OutputIt>
+std::size_t LoserTree<InputIt, Compare>::dequeueBatch(std::size_t k, OutputIt out) {
+	std::size_t written = 0;
+	while (written < k && !this->isEmpty()) {
+		*out = std::move(this->heads[0]);
+		++out;
+		this->advance();
+		written++;
+	}
+	return written;
+}
+
+template<typename InputIt, typename Compare>
+template<typename OutputIt>
+OutputIt LoserTree<InputIt, Compare>::drainInto(OutputIt out) {
+	while (!this->isEmpty()) {
+		*out = std::move(this->heads[0]);
+		++out;
+		this->advance();
+	}
+	return out;
+}
+
+template<typename InputIt, typename Compare>
+std::size_t LoserTree<InputIt, Compare>::sourceCount() const {
+	return this->k;
+}
+
+template<typename InputIt, typename Compare>
+bool LoserTree<InputIt, Compare>::isEmpty() const {
+	return this->tags[0] & DONE;
+}
+
+// merges ranges into out in one go, returns the advanced out
+template<typename InputIt, typename OutputIt,
+	typename Compare = std::less<typename std::iterator_traits<InputIt>::value_type> >
+OutputIt mergeSorted(const std::vector<std::pair<InputIt, InputIt> >& ranges, OutputIt out,
+	const Compare& comp = Compare()) {
+	LoserTree<InputIt, Compare> tree(ranges, comp);
+	return tree.drainInto(out);
+}
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef MULTI_PQ_H
+
+#define MULTI_PQ_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <pq.hh>
+
+/*
+ * MultiPq is a relaxed concurrent priority queue in the MultiQueue style
+ * (Rihani, Sanders, Dementiev). It is a set of Pq shards, each guarded
+ * by its own spinlock:
+ *
+ * - enqueue picks a random shard and try-locks it, moving on to another
+ *   random shard when it is busy, so producers never wait on each other.
+ * - dequeue samples two random shards, compares their cached top keys
+ *   without locking, and try-locks the better one. A busy or emptied
+ *   shard just means another pair is sampled.
+ *
+ * Each shard publishes its top key through an atomic after every change,
+ * so the two-choice comparison is lock free. Locks are only ever held
+ * for one Pq operation.
+ *
+ * Relaxation: dequeue returns a good item, not necessarily the best one.
+ * With s shards the rank of the returned item among everything queued
+ * is O(s) in expectation and O(s log s) with high probability (Alistarh
+ * et al., "The power of choice in priority scheduling", 2017). Use 2 to 4
+ * shards per thread. Fewer shards give tighter ordering and more
+ * contention. bench_multi_pq measures the actual rank error next to
+ * throughput.
+ *
+ * tryDequeue only returns an empty optional after a locked sweep has
+ * found every shard empty, so a quiescent queue is always drained.
+ */
+template<typename T, typename Key = int, typename Compare = std::greater<Key>,
+	std::size_t Arity = 4>
+class MultiPq {
+	static_assert(std::is_trivially_copyable<Key>::value,
+		"shard top keys are published through std::atomic<Key>");
+
+	public:
+		explicit MultiPq(std::size_t shards, const Compare& comp = Compare());
+
+		MultiPq(const MultiPq&) = delete;
+		MultiPq& operator=(const MultiPq&) = delete;
+
+		void enqueue(const T& item, Key priority);
+		void enqueue(T&& item, Key priority);
+		std::optional<T> tryDequeue();
+		// approximate while other threads are running
+		int count() const;
+		bool isEmpty() const;
+		std::size_t shardCount() const;
+	private:
+		struct alignas(64) Shard {
+			std::atomic<bool> locked{false};
+			std::atomic<bool> empty{true};
+			std::atomic<Key> top{};
+			Pq<T, Arity, Key, Compare> pq;
+		};
+
+		// takes over a shard locked by tryLock or lock, republishes its
+		// top and unlocks on the way out, also when a Pq operation throws
+		class ShardGuard {
+			public:
+				explicit ShardGuard(Shard& shard) : shard(shard) {}
+				~ShardGuard() {
+					publish(this->shard);
+					unlock(this->shard);
+				}
+
+				ShardGuard(const ShardGuard&) = delete;
+				ShardGuard& operator=(const ShardGuard&) = delete;
+			private:
+				Shard& shard;
+		};
+
+		std::unique_ptr<Shard[]> shards;
+		std::size_t numShards;
+		Compare comp;
+		std::atomic<std::ptrdiff_t> size{0};
+
+		static std::uint64_t nextRandom();
+		std::size_t randomShard();
+		static bool tryLock(Shard& shard);
+		static void lock(Shard& shard);
+		static void unlock(Shard& shard);
+		static void publish(Shard& shard);
+		template<typename U>
+		void push(U&& item, Key priority);
+		T popLocked(Shard& shard);
+};
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+MultiPq<T, Key, Compare, Arity>::MultiPq(std::size_t shards, const Compare& comp)
+	: shards(new Shard[shards == 0 ? 1 : shards]),
+	numShards(shards == 0 ? 1 : shards), comp(comp) {
+	for (std::size_t i = 0; i < this->numShards; i++) {
+		this->shards[i].pq = Pq<T, Arity, Key, Compare>(comp);
+	}
+}
+
+// xorshift64* per thread, seeded from the thread id so threads diverge
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::uint64_t MultiPq<T, Key, Compare, Arity>::nextRandom() {
+	static thread_local std::uint64_t state =
+		std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DULL;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::size_t MultiPq<T, Key, Compare, Arity>::randomShard() {
+	return nextRandom() % this->numShards;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool MultiPq<T, Key, Compare, Arity>::tryLock(Shard& shard) {
+	return !shard.locked.load(std::memory_order_relaxed) &&
+		!shard.locked.exchange(true, std::memory_order_acquire);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void MultiPq<T, Key, Compare, Arity>::lock(Shard& shard) {
+	while (!tryLock(shard)) {
+		std::this_thread::yield();
+	}
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void MultiPq<T, Key, Compare, Arity>::unlock(Shard& shard) {
+	shard.locked.store(false, std::memory_order_release);
+}
+
+// called with the shard locked, refreshes what lock free readers see
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void MultiPq<T, Key, Compare, Arity>::publish(Shard& shard) {
+	if (shard.pq.isEmpty()) {
+		shard.empty.store(true, std::memory_order_relaxed);
+		return;
+	}
+	shard.top.store(shard.pq.peekKey(), std::memory_order_relaxed);
+	shard.empty.store(false, std::memory_order_relaxed);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+template<typename U>
+void MultiPq<T, Key, Compare, Arity>::push(U&& item, Key priority) {
+	Shard* shard = &this->shards[this->randomShard()];
+	while (!tryLock(*shard)) {
+		shard = &this->shards[this->randomShard()];
+	}
+	{
+		ShardGuard guard(*shard);
+		shard->pq.enqueue(std::forward<U>(item), priority);
+	}
+	this->size.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void MultiPq<T, Key, Compare, Arity>::enqueue(const T& item, Key priority) {
+	this->push(item, priority);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void MultiPq<T, Key, Compare, Arity>::enqueue(T&& item, Key priority) {
+	this->push(std::move(item), priority);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+T MultiPq<T, Key, Compare, Arity>::popLocked(Shard& shard) {
+	ShardGuard guard(shard);
+	T result = shard.pq.dequeue();
+	this->size.fetch_sub(1, std::memory_order_relaxed);
+	return result;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::optional<T> MultiPq<T, Key, Compare, Arity>::tryDequeue() {
+	// fast path, two random choices compared on their published tops
+	for (std::size_t attempt = 0; attempt < 2 * this->numShards; attempt++) {
+		Shard& a = this->shards[this->randomShard()];
+		Shard& b = this->shards[this->randomShard()];
+		bool aEmpty = a.empty.load(std::memory_order_relaxed);
+		bool bEmpty = b.empty.load(std::memory_order_relaxed);
+		if (aEmpty && bEmpty) {
+			continue;
+		}
+
+		Shard* pick = &a;
+		if (aEmpty || (!bEmpty && this->comp(b.top.load(std::memory_order_relaxed),
+			a.top.load(std::memory_order_relaxed)))) {
+			pick = &b;
+		}
+
+		if (!tryLock(*pick)) {
+			continue;
+		}
+		if (pick->pq.isEmpty()) {
+			unlock(*pick);
+			continue;
+		}
+		return this->popLocked(*pick);
+	}
+
+	// slow path, sweep every shard so an empty answer is a real one
+	for (std::size_t i = 0; i < this->numShards; i++) {
+		Shard& shard = this->shards[i];
+		if (shard.empty.load(std::memory_order_relaxed)) {
+			continue;
+		}
+		lock(shard);
+		if (!shard.pq.isEmpty()) {
+			return this->popLocked(shard);
+		}
+		unlock(shard);
+	}
+	return std::nullopt;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+int MultiPq<T, Key, Compare, Arity>::count() const {
+	return this->size.load(std::memory_order_relaxed);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool MultiPq<T, Key, Compare, Arity>::isEmpty() const {
+	return this->count() <= 0;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::size_t MultiPq<T, Key, Compare, Arity>::shardCount() const {
+	return this->numShards;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef PACKED_PQ_H
+
+#define PACKED_PQ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <pq.hh>
+
+/*
+ * PackedPq stores a small payload inside the key. Each item is one
+ * unsigned word, the key in the high bits and the payload bytes in the
+ * low bits, kept in a key only Pq<void, ...>. A Pq<T> keeps a key vector
+ * and a payload vector side by side. Here there is only the one array,
+ * and a sift moves one scalar per level.
+ *
+ * - Key is an integer. Signed keys get their sign bit flipped, so plain
+ *   unsigned comparisons on the word order items by key.
+ * - T is trivially copyable and trivially default constructible, and is
+ *   copied in bitwise. Key and T together take at most 8 bytes, and the
+ *   word is 4 bytes when they fit in that.
+ * - Compare is std::greater<Key> or std::less<Key>. Any other order
+ *   would not survive the packing.
+ *
+ * A 2 byte key with a 2 byte payload packs into 4 bytes, half of what
+ * Pq takes. An int key with a 4 byte index is 8 bytes either way. While
+ * the heap fits in cache, one word per move makes PackedPq a little
+ * faster than Pq<std::uint32_t, 4>. Far past the LLC it is slower,
+ * because its 32 byte sibling groups straddle two cache lines half the
+ * time (see bench_compact). Equal keys come out in the order of their
+ * payload bits, which Pq leaves unspecified anyway. peek() returns a
+ * copy because no T is stored.
+ */
+template<typename T, typename Key = int, typename Compare = std::greater<Key>,
+	std::size_t Arity = 4>
+class PackedPq {
+	static_assert(std::is_trivially_copyable<T>::value, "PackedPq payloads are copied bitwise");
+	// payload() default constructs a T to copy the bytes into
+	static_assert(std::is_trivially_default_constructible<T>::value,
+		"PackedPq payloads have to be trivially default constructible");
+	static_assert(std::is_integral<Key>::value && !std::is_same<Key, bool>::value,
+		"PackedPq needs integer keys");
+	static_assert(sizeof(Key) + sizeof(T) <= 8, "key and payload have to fit in 8 bytes");
+	static_assert(std::is_same<Compare, std::greater<Key> >::value ||
+		std::is_same<Compare, std::less<Key> >::value,
+		"PackedPq orders by std::greater or std::less on the key");
+	static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "payloads sit in the low bytes");
+
+	public:
+		typedef typename std::conditional<sizeof(Key) + sizeof(T) <= 4,
+			std::uint32_t, std::uint64_t>::type Word;
+
+		void enqueue(const T& item, Key priority);
+		// throws std::out_of_range when empty
+		T dequeue();
+		std::optional<T> tryDequeue();
+		template<typename OutputIt>
+		std::size_t dequeueBatch(std::size_t k, OutputIt out);
+		void replaceTop(const T& item, Key priority);
+		T peek() const;
+		Key peekKey() const;
+		int count() const;
+		bool isEmpty() const;
+		void reserve(std::size_t n);
+	private:
+		typedef typename std::make_unsigned<Key>::type Bits;
+		typedef typename std::conditional<std::is_same<Compare, std::greater<Key> >::value,
+			std::greater<Word>, std::less<Word> >::type WordCompare;
+
+		static constexpr unsigned PAYLOAD_BITS = 8 * sizeof(T);
+		static constexpr Bits SIGN = std::is_signed<Key>::value
+			? Bits(Bits(1) << (std::numeric_limits<Bits>::digits - 1)) : Bits(0);
+
+		Pq<void, Arity, Word, WordCompare> heap;
+
+		static Word pack(const T& item, Key priority);
+		static T payload(Word word);
+		static Key key(Word word);
+};
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+typename PackedPq<T, Key, Compare, Arity>::Word PackedPq<T, Key, Compare, Arity>::pack(
+	const T& item, Key priority) {
+	Word low = 0;
+	std::memcpy(&low, &item, sizeof(T));
+	return (static_cast<Word>(static_cast<Bits>(priority) ^ SIGN) << PAYLOAD_BITS) | low;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+T PackedPq<T, Key, Compare, Arity>::payload(Word word) {
+	T item;
+	std::memcpy(&item, &word, sizeof(T));
+	return item;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+Key PackedPq<T, Key, Compare, Arity>::key(Word word) {
+	return static_cast<Key>(static_cast<Bits>(word >> PAYLOAD_BITS) ^ SIGN);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void PackedPq<T, Key, Compare, Arity>::enqueue(const T& item, Key priority) {
+	this->heap.enqueue(pack(item, priority));
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+T PackedPq<T, Key, Compare, Arity>::dequeue() {
+	if (this->heap.isEmpty()) {
+		throw std::out_of_range("dequeue on empty PackedPq");
+	}
+	return payload(this->heap.dequeue());
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::optional<T> PackedPq<T, Key, Compare, Arity>::tryDequeue() {
+	if (this->heap.isEmpty()) {
+		return std::nullopt;
+	}
+	return payload(this->heap.dequeue());
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+template<typename OutputIt>
+std::size_t PackedPq<T, Key, Compare, Arity>::dequeueBatch(std::size_t k, OutputIt out) {
+	std::size_t n = k < static_cast<std::size_t>(this->heap.count()) ? k : this->heap.count();
+	for (std::size_t i = 0; i < n; i++) {
+		*out = payload(this->heap.dequeue());
+		++out;
+	}
+	return n;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void PackedPq<T, Key, Compare, Arity>::replaceTop(const T& item, Key priority) {
+	if (this->heap.isEmpty()) {
+		throw std::out_of_range("replaceTop on empty PackedPq");
+	}
+	this->heap.replaceTop(pack(item, priority));
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+T PackedPq<T, Key, Compare, Arity>::peek() const {
+	if (this->heap.isEmpty()) {
+		throw std::out_of_range("peek on empty PackedPq");
+	}
+	return payload(this->heap.peekKey());
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+Key PackedPq<T, Key, Compare, Arity>::peekKey() const {
+	if (this->heap.isEmpty()) {
+		throw std::out_of_range("peekKey on empty PackedPq");
+	}
+	return key(this->heap.peekKey());
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+int PackedPq<T, Key, Compare, Arity>::count() const {
+	return this->heap.count();
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool PackedPq<T, Key, Compare, Arity>::isEmpty() const {
+	return this->heap.isEmpty();
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void PackedPq<T, Key, Compare, Arity>::reserve(std::size_t n) {
+	this->heap.reserve(n);
+}
+
+#endif
@@ -2,142 +2,1821 @@
 
 #define PQ_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <iostream>
+#include <ostream>
+#include "pq_stats.hh"
 
-template<typename T>
-struct HeapNode {
-	int key;
-	T val;
-};
+#if defined(__SSE2__) && !defined(PQ_NO_SIMD)
+#include <immintrin.h>
+#endif
+
+/*
+ * Ordering is a compile time Compare policy over Key. comp(a, b) is true
+ * when a belongs closer to the top than b, so std::greater (the default)
+ * gives a max heap and std::less a min heap. Stateful comparators are
+ * stored by value and never dispatched virtually.
+ *
+ * Storage is flat and pointer free. Keys live in their own dense vector
+ * and payloads live in a parallel vector at the same index, so sifting
+ * only ever compares against the key vector and a payload is moved at
+ * most once per level it travels.
+ *
+ * Arity is the number of children per node. 2 is the classic binary heap,
+ * 4 and 8 give a shallower tree whose sibling keys sit next to each other
+ * so picking the best child touches one cache line.
+ *
+ * Alloc is a standard allocator for T and is rebound for the key vector,
+ * so both vectors draw from the same place. With a
+ * std::pmr::polymorphic_allocator (see PmrPq in pq_alloc.hh) a queue can
+ * live entirely inside an arena or pool and never touch the global heap.
+ *
+ * Stats is an instrumentation policy from pq_stats.hh. The default NoStats
+ * compiles away. CountingStats and ProfilingStats count comparisons, moves
+ * and sift depths, and time operations, read back through stats().
+ *
+ * Layout maps tree positions to storage slots. ImplicitLayout is the
+ * classic breadth first array. BlockedLayout packs subtrees into blocks
+ * so that a sift touches one page (or cache line) per block instead of
+ * one per level, which matters once the heap is far bigger than the LLC.
+ */
+
+struct ImplicitLayout;
+
+template<typename T, std::size_t Arity = 2, typename Key = int,
+	typename Compare = std::greater<Key>, typename Alloc = std::allocator<T>,
+	typename Stats = NoStats, typename Layout = ImplicitLayout>
+class Pq : private Stats {
+	static_assert(Arity >= 2, "a heap needs at least two children per node");
+	// payloads live in a std::vector<T>, and std::vector<bool> packs bits,
+	// so peek() would return a reference to a temporary. Wrap the bool in
+	// a struct, or use Pq<std::uint8_t>.
+	static_assert(!std::is_same<T, bool>::value, "Pq<bool> is not supported, wrap the bool");
 
-// internally this is only a MaxHeap
-template<typename T>
-class Pq {
 	public:
+		typedef Alloc allocator_type;
+
+		Pq() = default;
+		explicit Pq(const Compare& comp, const Alloc& alloc = Alloc());
+		explicit Pq(const Alloc& alloc);
+		// build from (item, priority) pairs in O(n) with Floyd's heapify
+		template<typename InputIt>
+		Pq(InputIt first, InputIt last, const Compare& comp = Compare(),
+			const Alloc& alloc = Alloc());
+
 		// content of item is copied or moved
-		void enqueue(const T& item, int priority);
+		void enqueue(const T& item, Key priority);
+		void enqueue(T&& item, Key priority);
+		// construct the payload in place from args
+		template<typename... Args>
+		void emplace(Key priority, Args&&... args);
+		// append (item, priority) pairs then restore the heap bottom up
+		template<typename InputIt>
+		void enqueueBulk(InputIt first, InputIt last);
+		template<typename Range>
+		void enqueueBulk(const Range& items);
+		// the payload is moved out, throws std::out_of_range when empty
 		T dequeue();
+		// like dequeue but returns an empty optional instead of throwing
+		std::optional<T> tryDequeue();
+		// pop up to k items in priority order into out, returns how many
+		template<typename OutputIt>
+		std::size_t dequeueBatch(std::size_t k, OutputIt out);
+		// drop the top and enqueue item in one sift, throws when empty
+		void replaceTop(const T& item, Key priority);
+		void replaceTop(T&& item, Key priority);
 		// peek returns a readonly reference
 		const T& peek() const;
+		// priority of the item peek would return
+		Key peekKey() const;
 		int count() const;
 		bool isEmpty() const;
+		void reserve(std::size_t n);
+		Alloc get_allocator() const;
+		// counters collected by the Stats policy, all zero with NoStats
+		PqStatsSnapshot stats() const;
+		void resetStats();
 		void print() const;
+		/*
+		 * Level by level view of the first levels of the heap. Levels with
+		 * more than perLevel keys are sampled at an even stride, so the cost
+		 * is bounded by levels * perLevel whatever the size of the queue.
+		 */
+		void dump(std::ostream& os, std::size_t levels = 6, std::size_t perLevel = 8) const;
 	private:
-		std::vector<std::unique_ptr<HeapNode<T> > > internalHeap;
+		typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Key> KeyAlloc;
+
+		// keys[i] is the priority of vals[i]
+		std::vector<Key, KeyAlloc> keys;
+		std::vector<T, Alloc> vals;
+		Compare comp;
+
+		template<typename... Args>
+		void append(Key key, Args&&... args);
+		void siftUp(std::size_t hole);
+		void siftDown(std::size_t hole, Key key, T&& val);
+		void heapifyFrom(std::size_t lo);
+		void popRoot();
 };
 
-inline int parentIdx(int idx) {
-	return (idx-1) / 2;
+template<std::size_t Arity = 2>
+inline std::size_t parentIdx(std::size_t idx) {
+	return (idx-1) / Arity;
 }
 
-inline int leftChild(int idx) {
-	return (2*idx) + 1;
+template<std::size_t Arity = 2>
+inline std::size_t firstChild(std::size_t idx) {
+	return (Arity*idx) + 1;
 }
 
-inline int rightChild(int idx) {
-	return (2*idx) + 2;
+/*
+ * A Layout tells Pq where the parent and the first child of a slot live.
+ * The Arity children of a slot are always adjacent and every slot's
+ * parent sits at a lower index, so any prefix of the storage is a
+ * complete tree and the back slot is always a leaf. LEVEL_ORDER says
+ * whether each tree level is one contiguous range of slots.
+ */
+struct ImplicitLayout {
+	static constexpr bool LEVEL_ORDER = true;
+
+	template<std::size_t Arity>
+	static std::size_t parent(std::size_t idx) {
+		return parentIdx<Arity>(idx);
+	}
+
+	template<std::size_t Arity>
+	static std::size_t child(std::size_t idx) {
+		return firstChild<Arity>(idx);
+	}
+};
+
+template<std::size_t Base, std::size_t Exp>
+struct StaticPow {
+	static constexpr std::size_t value = Base * StaticPow<Base, Exp - 1>::value;
+};
+
+template<std::size_t Base>
+struct StaticPow<Base, 0> {
+	static constexpr std::size_t value = 1;
+};
+
+/*
+ * B-heap style blocking. Slot 0 is the root and the rest of the storage
+ * is cut into blocks of NODES slots. A block holds Arity sibling subtrees
+ * Levels deep, breadth first across the block, so its first Arity slots
+ * are one sibling group. Each slot in the bottom row of a block has a
+ * whole block as its children, and blocks are numbered like a heap of
+ * blocks with FANOUT children per block, filled one after the other.
+ *
+ * A sift stays inside one block for Levels levels before it jumps, so it
+ * touches about log(n) / Levels blocks instead of one page or cache line
+ * per level. Siblings stay adjacent, so child selection is the same SIMD
+ * scan as with ImplicitLayout. With 4 byte keys, BlockedLayout<9> on a
+ * binary heap is 1022 slots, just under a 4 KiB page, and
+ * BlockedLayout<3> is 14 slots, under a cache line. Blocks are not
+ * aligned, so a block can straddle two pages or lines.
+ */
+template<std::size_t Levels>
+struct BlockedLayout {
+	static_assert(Levels >= 1, "a block needs at least one level");
+
+	static constexpr bool LEVEL_ORDER = false;
+
+	template<std::size_t Arity>
+	struct Shape {
+		static constexpr std::size_t LEAVES = StaticPow<Arity, Levels>::value;
+		static constexpr std::size_t NODES = Arity * (LEAVES - 1) / (Arity - 1);
+		static constexpr std::size_t FIRST_LEAF = NODES - LEAVES;
+		static constexpr std::size_t FANOUT = LEAVES;
+	};
+
+	template<std::size_t Arity>
+	static std::size_t parent(std::size_t idx) {
+		typedef Shape<Arity> S;
+		std::size_t block = (idx - 1) / S::NODES;
+		std::size_t local = idx - 1 - block * S::NODES;
+		if (local >= Arity) {
+			return 1 + block * S::NODES + local / Arity - 1;
+		}
+		if (block == 0) {
+			return 0;
+		}
+		std::size_t up = (block - 1) / S::FANOUT;
+		std::size_t leaf = block - 1 - up * S::FANOUT;
+		return 1 + up * S::NODES + S::FIRST_LEAF + leaf;
+	}
+
+	template<std::size_t Arity>
+	static std::size_t child(std::size_t idx) {
+		typedef Shape<Arity> S;
+		if (idx == 0) {
+			return 1;
+		}
+		std::size_t block = (idx - 1) / S::NODES;
+		std::size_t local = idx - 1 - block * S::NODES;
+		if (local < S::FIRST_LEAF) {
+			return 1 + block * S::NODES + Arity * (local + 1);
+		}
+		return 1 + (block * S::FANOUT + 1 + local - S::FIRST_LEAF) * S::NODES;
+	}
+};
+
+/*
+ * BestChild picks the offset of the key that ranks highest under Compare
+ * among n sibling keys. The generic version is a plain scan. For int keys
+ * ordered by std::greater or std::less with arity 4 or 8, a full sibling
+ * group is reduced with SSE2 / AVX2, partial groups at the bottom of the
+ * heap fall back to the scan. Ties go to the lowest offset in both paths.
+ * Define PQ_NO_SIMD to force the scalar path.
+ */
+template<typename Key, typename Compare>
+inline std::size_t scanBestChild(const Key* children, std::size_t n, const Compare& comp) {
+	std::size_t best = 0;
+	for (std::size_t i = 1; i < n; i++) {
+		if (comp(children[i], children[best])) {
+			best = i;
+		}
+	}
+	return best;
 }
 
+template<typename Key, typename Compare, std::size_t Arity>
+struct BestChild {
+	static std::size_t select(const Key* children, std::size_t n, const Compare& comp) {
+		return scanBestChild(children, n, comp);
+	}
+};
+
 /*
- * We are basically implementing a max heap
- * the maximum element stays at the top of it.
+ * Four 64 bit siblings, as in PackedPq, take two matches and a final.
+ * The winners are picked with arithmetic rather than branches, which
+ * on random keys would miss about half the time.
+ */
+template<typename Word>
+struct TournamentBestChild4 {
+	template<typename Compare>
+	static std::size_t select(const Word* children, std::size_t n, const Compare& comp) {
+		if (n < 4) {
+			return scanBestChild(children, n, comp);
+		}
+		std::size_t a = comp(children[1], children[0]);
+		std::size_t b = 2 + comp(children[3], children[2]);
+		return a + (b - a) * comp(children[b], children[a]);
+	}
+};
+
+template<>
+struct BestChild<std::uint64_t, std::greater<std::uint64_t>, 4>
+	: TournamentBestChild4<std::uint64_t> {};
+template<>
+struct BestChild<std::uint64_t, std::less<std::uint64_t>, 4>
+	: TournamentBestChild4<std::uint64_t> {};
+
+#if defined(__SSE2__) && !defined(PQ_NO_SIMD)
+
+// lane wise max when Max is set, min otherwise
+template<bool Max>
+inline __m128i bestEpi32(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+	return Max ? _mm_max_epi32(a, b) : _mm_min_epi32(a, b);
+#else
+	__m128i takeA = Max ? _mm_cmpgt_epi32(a, b) : _mm_cmplt_epi32(a, b);
+	return _mm_or_si128(_mm_and_si128(takeA, a), _mm_andnot_si128(takeA, b));
+#endif
+}
+
+// broadcast the best of the four lanes to every lane
+template<bool Max>
+inline __m128i hbestEpi32(__m128i v) {
+	v = bestEpi32<Max>(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return bestEpi32<Max>(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+template<bool Max>
+struct SimdBestChild4 {
+	template<typename Compare>
+	static std::size_t select(const int* children, std::size_t n, const Compare& comp) {
+		if (n < 4) {
+			return scanBestChild(children, n, comp);
+		}
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(children));
+		__m128i eq = _mm_cmpeq_epi32(v, hbestEpi32<Max>(v));
+		return __builtin_ctz(_mm_movemask_ps(_mm_castsi128_ps(eq)));
+	}
+};
+
+template<bool Max>
+struct SimdBestChild8 {
+	template<typename Compare>
+	static std::size_t select(const int* children, std::size_t n, const Compare& comp) {
+		if (n < 8) {
+			return scanBestChild(children, n, comp);
+		}
+#ifdef __AVX2__
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(children));
+		__m256i m = Max ? _mm256_max_epi32(v, _mm256_permute2x128_si256(v, v, 1))
+			: _mm256_min_epi32(v, _mm256_permute2x128_si256(v, v, 1));
+		__m256i s = _mm256_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1));
+		m = Max ? _mm256_max_epi32(m, s) : _mm256_min_epi32(m, s);
+		s = _mm256_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2));
+		m = Max ? _mm256_max_epi32(m, s) : _mm256_min_epi32(m, s);
+		__m256i eq = _mm256_cmpeq_epi32(v, m);
+		return __builtin_ctz(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+#else
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(children));
+		__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(children + 4));
+		__m128i m = hbestEpi32<Max>(bestEpi32<Max>(lo, hi));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, m))) |
+			(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, m))) << 4);
+		return __builtin_ctz(mask);
+#endif
+	}
+};
+
+template<>
+struct BestChild<int, std::greater<int>, 4> : SimdBestChild4<true> {};
+template<>
+struct BestChild<int, std::less<int>, 4> : SimdBestChild4<false> {};
+template<>
+struct BestChild<int, std::greater<int>, 8> : SimdBestChild8<true> {};
+template<>
+struct BestChild<int, std::less<int>, 8> : SimdBestChild8<false> {};
+
+#endif
+
+// the levels part of Pq::dump, shared with the key only Pq
+template<std::size_t Arity, typename Layout, typename Key>
+void dumpLevels(std::ostream& os, const Key* keys, std::size_t n, std::size_t levels,
+	std::size_t perLevel) {
+	if constexpr (!Layout::LEVEL_ORDER) {
+		// levels are scattered over blocks, so follow the children of the keys shown
+		std::vector<std::size_t> shown(n > 0 ? 1 : 0, 0);
+		for (std::size_t level = 0; level < levels && !shown.empty(); level++) {
+			os << "  L" << level << ":";
+			std::vector<std::size_t> next;
+			for (std::size_t idx : shown) {
+				os << " " << keys[idx];
+				std::size_t first = Layout::template child<Arity>(idx);
+				for (std::size_t c = first; c < first + Arity && c < n && next.size() < perLevel; c++) {
+					next.push_back(c);
+				}
+			}
+			os << "\n";
+			shown.swap(next);
+		}
+		return;
+	}
+
+	std::size_t start = 0;
+	std::size_t width = 1;
+	for (std::size_t level = 0; level < levels && start < n; level++) {
+		std::size_t count = n - start < width ? n - start : width;
+		std::size_t stride = count > perLevel && perLevel > 0 ? count / perLevel : 1;
+
+		os << "  L" << level << " " << count << (count == 1 ? " key" : " keys");
+		if (stride > 1) {
+			os << ", sampled every " << stride;
+		}
+		os << ":";
+		for (std::size_t i = 0, shown = 0; i < count && shown < perLevel; i += stride, shown++) {
+			os << " " << keys[start + i];
+		}
+		os << "\n";
+
+		start += width;
+		width *= Arity;
+	}
+	if (start < n) {
+		os << "  ... " << n - start << " more keys below\n";
+	}
+}
+
+/*
+ * We are basically implementing a max heap, with Compare deciding what
+ * max means. The element that ranks highest stays at the top of it.
  * */
 
 /*
  * Insert item at bottom and bubble up,
  * back and SIFT UP
  */
-template<typename T>
-void Pq<T>::enqueue(const T& item, int priority) {	
-	this->internalHeap.push_back(
-		std::make_unique<HeapNode<T>>(HeapNode<T>{priority, item})
-	);
-	
-	int curr = this->internalHeap.size() - 1;
-	while (curr > 0) {
-		int parent = parentIdx(curr);
-		if (parent < 0) {
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::enqueue(const T& item, Key priority) {
+	typename Stats::Timer timer = this->statStart();
+	this->append(priority, item);
+	this->siftUp(this->keys.size() - 1);
+	this->statFinish(PqOp::ENQUEUE, timer);
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::enqueue(T&& item, Key priority) {
+	typename Stats::Timer timer = this->statStart();
+	this->append(priority, std::move(item));
+	this->siftUp(this->keys.size() - 1);
+	this->statFinish(PqOp::ENQUEUE, timer);
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+template<typename... Args>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::emplace(Key priority, Args&&... args) {
+	typename Stats::Timer timer = this->statStart();
+	this->append(priority, std::forward<Args>(args)...);
+	this->siftUp(this->keys.size() - 1);
+	this->statFinish(PqOp::ENQUEUE, timer);
+};
+
+/*
+ * Push a key and construct its payload at the back. If building the
+ * payload throws the key is taken back off so both vectors stay the
+ * same length.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+template<typename... Args>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::append(Key key, Args&&... args) {
+	this->keys.push_back(key);
+	try {
+		this->vals.emplace_back(std::forward<Args>(args)...);
+	} catch (...) {
+		this->keys.pop_back();
+		throw;
+	}
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::Pq(const Compare& comp, const Alloc& alloc)
+	: keys(KeyAlloc(alloc)), vals(alloc), comp(comp) {
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::Pq(const Alloc& alloc)
+	: keys(KeyAlloc(alloc)), vals(alloc) {
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+template<typename InputIt>
+Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::Pq(InputIt first, InputIt last, const Compare& comp,
+	const Alloc& alloc)
+	: keys(KeyAlloc(alloc)), vals(alloc), comp(comp) {
+	this->enqueueBulk(first, last);
+}
+
+/*
+ * Append everything first and fix the heap afterwards. On an empty queue
+ * this is exactly Floyd's heapify, otherwise only the ancestors of the
+ * appended slots get sifted, see heapifyFrom.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+template<typename InputIt>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::enqueueBulk(InputIt first, InputIt last) {
+	using Category = typename std::iterator_traits<InputIt>::iterator_category;
+	if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value) {
+		// grow geometrically, an exact reserve per batch would copy the
+		// whole heap on every call
+		std::size_t needed = this->keys.size() + std::distance(first, last);
+		if (needed > this->keys.capacity()) {
+			std::size_t doubled = 2 * this->keys.capacity();
+			this->reserve(needed > doubled ? needed : doubled);
+		}
+	}
+
+	std::size_t lo = this->keys.size();
+	for (; first != last; ++first) {
+		auto&& entry = *first;
+		this->append(entry.second, std::forward<decltype(entry)>(entry).first);
+	}
+	this->heapifyFrom(lo);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+template<typename Range>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::enqueueBulk(const Range& items) {
+	this->enqueueBulk(std::begin(items), std::end(items));
+}
+
+/*
+ * Everything in [0, lo) is already a heap and [lo, size) is unordered.
+ * Only ancestors of the new slots can be out of place, and at every level
+ * they form one contiguous index range: sift that range down from the
+ * back, move to the parents of the range and repeat until the root.
+ * With lo == 0 this degenerates into the classic O(n) bottom up build.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::heapifyFrom(std::size_t lo) {
+	const std::size_t n = this->keys.size();
+	if (n < 2 || lo >= n) {
+		return;
+	}
+
+	if constexpr (!Layout::LEVEL_ORDER) {
+		/*
+		 * Levels are not ranges here. A few appended items are sifted up
+		 * one by one, otherwise everything is rebuilt bottom up, which
+		 * works because every child sits at a higher index than its parent.
+		 */
+		if (lo > 0 && n - lo < lo) {
+			for (std::size_t i = lo; i < n; i++) {
+				this->siftUp(i);
+			}
+			return;
+		}
+		for (std::size_t i = n; i-- > 0;) {
+			if (Layout::template child<Arity>(i) < n) {
+				T val = std::move(this->vals[i]);
+				this->siftDown(i, this->keys[i], std::move(val));
+			}
+		}
+		return;
+	}
+
+	std::size_t hi = parentIdx<Arity>(n - 1);
+	lo = lo == 0 ? 0 : parentIdx<Arity>(lo);
+	while (true) {
+		for (std::size_t i = hi + 1; i-- > lo;) {
+			T val = std::move(this->vals[i]);
+			this->siftDown(i, this->keys[i], std::move(val));
+		}
+		if (lo == 0) {
 			break;
 		}
-		// get non-owning reference for readonly access
-		const HeapNode<T>& parentNode = *this->internalHeap.at(parent);
-		if (parentNode.key > priority) {
-			// we have reached a valid position 
+		lo = parentIdx<Arity>(lo);
+		hi = parentIdx<Arity>(hi);
+	}
+}
+
+/*
+ * Rather than swapping at every level we lift the new item out, pull
+ * lower ranked parents down into the hole and drop the item in at the end.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::siftUp(std::size_t hole) {
+	const Key key = this->keys[hole];
+	if (hole == 0 || this->comp(this->keys[Layout::template parent<Arity>(hole)], key)) {
+		// already in a valid position, nothing to move
+		this->statCompares(hole != 0);
+		this->statSiftUp(0);
+		return;
+	}
+
+	T val = std::move(this->vals[hole]);
+	std::size_t levels = 0;
+	while (hole > 0) {
+		std::size_t parent = Layout::template parent<Arity>(hole);
+		if (this->comp(this->keys[parent], key)) {
+			// we have reached a valid position
 			break;
 		}
-		// perform swap
-		std::swap(this->internalHeap[parent], this->internalHeap[curr]);
-		curr = parent;
+		this->keys[hole] = this->keys[parent];
+		this->vals[hole] = std::move(this->vals[parent]);
+		hole = parent;
+		levels++;
 	}
-};
+	this->keys[hole] = key;
+	this->vals[hole] = std::move(val);
+
+	// the early check, one per level moved and the one that stopped it
+	this->statCompares(1 + levels + (hole != 0));
+	this->statMoves(levels);
+	this->statSiftUp(levels);
+}
 
 /*
  * To dequeue remove item at top, replace it with item at the bottom
- * Now bubble the item down, swapping with the larger child
- * TOP and SIFT DOWN, SWAP with larger child!
+ * Now bubble the item down, swapping with the best child
+ * TOP and SIFT DOWN, SWAP with best child!
  * */
-template<typename T>
-T Pq<T>::dequeue() {
-	// move the ptr and it's ownership out of the index 0 on vec
-    std::unique_ptr<HeapNode<T> > resultN = std::move(this->internalHeap.at(0));
-	
-	// replace the idx 0 of vec with the last element in vec
-    this->internalHeap[0] = std::move(this->internalHeap.back());
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+T Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::dequeue() {
+	if (this->keys.empty()) {
+		throw std::out_of_range("dequeue on empty Pq");
+	}
+
+	typename Stats::Timer timer = this->statStart();
+	T result = std::move(this->vals[0]);
+	this->popRoot();
+	this->statFinish(PqOp::DEQUEUE, timer);
+	return result;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+std::optional<T> Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::tryDequeue() {
+	if (this->keys.empty()) {
+		return std::nullopt;
+	}
+
+	typename Stats::Timer timer = this->statStart();
+	std::optional<T> result(std::move(this->vals[0]));
+	this->popRoot();
+	this->statFinish(PqOp::DEQUEUE, timer);
+	return result;
+}
+
+/*
+ * Pops without the per call empty check and without building a return
+ * value per item, the caller owns the iterator the items are moved into.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+template<typename OutputIt>
+std::size_t Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::dequeueBatch(std::size_t k, OutputIt out) {
+	std::size_t n = k < this->keys.size() ? k : this->keys.size();
+	for (std::size_t i = 0; i < n; i++) {
+		typename Stats::Timer timer = this->statStart();
+		*out = std::move(this->vals[0]);
+		++out;
+		this->popRoot();
+		this->statFinish(PqOp::DEQUEUE, timer);
+	}
+	return n;
+}
+
+/*
+ * Same result as a dequeue followed by an enqueue, but the new item goes
+ * straight into the root and only one sift down is paid for.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::replaceTop(const T& item, Key priority) {
+	this->replaceTop(T(item), priority);
+}
 
-	// get rid of last element in vec because it has null value
-    this->internalHeap.pop_back();
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::replaceTop(T&& item, Key priority) {
+	if (this->keys.empty()) {
+		throw std::out_of_range("replaceTop on empty Pq");
+	}
+	typename Stats::Timer timer = this->statStart();
+	this->siftDown(0, priority, std::move(item));
+	this->statFinish(PqOp::REPLACE_TOP, timer);
+}
+
+/*
+ * The root's payload has already been moved out by the caller. Take the
+ * last element out and re-seat it from the top.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::popRoot() {
+	Key lastKey = this->keys.back();
+	T last = std::move(this->vals.back());
+	this->keys.pop_back();
+	this->vals.pop_back();
+
+	if (!this->keys.empty()) {
+		this->siftDown(0, lastKey, std::move(last));
+	}
+}
 
-    int limit = this->internalHeap.size();
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::siftDown(std::size_t hole, Key key, T&& val) {
+	const std::size_t limit = this->keys.size();
+	// only read by the stats hooks, dead code with NoStats
+	std::size_t levels = 0;
+	std::size_t compares = 0;
 
-    int curr = 0;
-    while (curr < limit) {
-        int leftChildIdx = leftChild(curr);
-        int rightChildIdx = rightChild(curr);
+	while (true) {
+		std::size_t first = Layout::template child<Arity>(hole);
+		if (first >= limit) {
+			break;
+		}
 
-        int childToSwapWith = curr;
-        if (leftChildIdx < limit &&
-            this->internalHeap[leftChildIdx]->key > this->internalHeap[childToSwapWith]->key) {
-            childToSwapWith = leftChildIdx;
-        }
+		std::size_t siblings = limit - first < Arity ? limit - first : Arity;
+		std::size_t childToSwapWith = first +
+			BestChild<Key, Compare, Arity>::select(&this->keys[first], siblings, this->comp);
+		compares += siblings;
 
-        if (rightChildIdx < limit &&
-            this->internalHeap[rightChildIdx]->key > this->internalHeap[childToSwapWith]->key) {
-            childToSwapWith = rightChildIdx;
-        }
+		if (!this->comp(this->keys[childToSwapWith], key)) {
+			break;
+		}
 
-        if (childToSwapWith == curr) {
-            break;
-        }
+		this->keys[hole] = this->keys[childToSwapWith];
+		this->vals[hole] = std::move(this->vals[childToSwapWith]);
+		hole = childToSwapWith;
+		levels++;
+	}
 
-		std::swap(this->internalHeap[curr], this->internalHeap[childToSwapWith]);
-        curr = childToSwapWith;
-    }
+	this->keys[hole] = key;
+	this->vals[hole] = std::move(val);
 
-    return resultN->val;
+	this->statCompares(compares);
+	this->statMoves(levels);
+	this->statSiftDown(levels);
 }
 
-template<typename T>
-const T& Pq<T>::peek() const {
-	return this->internalHeap.at(0)->val;		
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+const T& Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::peek() const {
+	if (this->keys.empty()) {
+		throw std::out_of_range("peek on empty Pq");
+	}
+	return this->vals[0];
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+Key Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::peekKey() const {
+	if (this->keys.empty()) {
+		throw std::out_of_range("peekKey on empty Pq");
+	}
+	return this->keys[0];
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+int Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::count() const {
+	return this->keys.size();
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+bool Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::isEmpty() const {
+	return this->keys.size() == 0;
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::reserve(std::size_t n) {
+	this->keys.reserve(n);
+	this->vals.reserve(n);
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+Alloc Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::get_allocator() const {
+	return this->vals.get_allocator();
 };
 
-template<typename T>
-int Pq<T>::count() const {
-	return this->internalHeap.size();
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+PqStatsSnapshot Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::stats() const {
+	return this->statSnapshot();
 };
 
-template<typename T>
-bool Pq<T>::isEmpty() const {
-	return this->internalHeap.size() == 0;
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::resetStats() {
+	this->statReset();
 };
 
-template<typename T>
-void Pq<T>::print() const {
-	for (int i = 0; i < this->internalHeap.size(); i++) {
-		std::cout << this->internalHeap[i]->key << std::endl;
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::print() const {
+	for (std::size_t i = 0; i < this->keys.size(); i++) {
+		std::cout << this->keys[i] << std::endl;
 	}
 };
 
+template<typename T, std::size_t Arity, typename Key, typename Compare, typename Alloc,
+	typename Stats, typename Layout>
+void Pq<T, Arity, Key, Compare, Alloc, Stats, Layout>::dump(std::ostream& os, std::size_t levels, std::size_t perLevel) const {
+	os << "Pq size " << this->keys.size() << " arity " << Arity << "\n";
+	dumpLevels<Arity, Layout>(os, this->keys.data(), this->keys.size(), levels, perLevel);
+};
+
+/*
+ * AddressablePq is an indexed d-ary heap. enqueue hands back a Handle
+ * that stays valid until its item leaves the queue, and the handle can
+ * be used to re-prioritize (updateKey) or remove (erase) the item in
+ * O(log n). Heap order is kept the same way as Pq: a dense key vector
+ * for the sift loops plus a parallel vector of slot ids. Payloads never
+ * move, they sit in a slot vector indexed by the handle, and pos maps a
+ * slot back to its current heap index. Freed slots are recycled and a
+ * generation count per slot makes stale handles detectable.
+ */
+template<typename T, std::size_t Arity = 2, typename Key = int,
+	typename Compare = std::greater<Key> >
+class AddressablePq {
+	static_assert(Arity >= 2, "a heap needs at least two children per node");
+	// same std::vector<bool> problem as Pq, peek() would dangle
+	static_assert(!std::is_same<T, bool>::value, "AddressablePq<bool> is not supported, wrap the bool");
+
+	public:
+		struct Handle {
+			std::size_t slot;
+			std::size_t generation;
+		};
+
+		AddressablePq() = default;
+		explicit AddressablePq(const Compare& comp);
+
+		Handle enqueue(const T& item, Key priority);
+		Handle enqueue(T&& item, Key priority);
+		template<typename... Args>
+		Handle emplace(Key priority, Args&&... args);
+		// move an item up or down after its priority changed
+		void updateKey(Handle handle, Key priority);
+		// take an item out from anywhere in the heap
+		T erase(Handle handle);
+		// false once the item behind handle was dequeued or erased
+		bool contains(Handle handle) const;
+		Key keyOf(Handle handle) const;
+		const T& get(Handle handle) const;
+
+		T dequeue();
+		std::optional<T> tryDequeue();
+		const T& peek() const;
+		Key peekKey() const;
+		int count() const;
+		bool isEmpty() const;
+		void reserve(std::size_t n);
+		void print() const;
+	private:
+		static constexpr std::size_t NOT_QUEUED = static_cast<std::size_t>(-1);
+
+		// heap order: keys[i] belongs to the item in slot slotAt[i]
+		std::vector<Key> keys;
+		std::vector<std::size_t> slotAt;
+		// slot order: payload, heap index and generation of each slot
+		std::vector<T> vals;
+		std::vector<std::size_t> pos;
+		std::vector<std::size_t> generations;
+		std::vector<std::size_t> freeSlots;
+		Compare comp;
+
+		template<typename... Args>
+		Handle insert(Key key, Args&&... args);
+		void place(std::size_t idx, Key key, std::size_t slot);
+		void siftUp(std::size_t hole, Key key, std::size_t slot);
+		void siftDown(std::size_t hole, Key key, std::size_t slot);
+		T removeAt(std::size_t idx);
+		std::size_t checkedIndex(Handle handle) const;
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+AddressablePq<T, Arity, Key, Compare>::AddressablePq(const Compare& comp) : comp(comp) {
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+typename AddressablePq<T, Arity, Key, Compare>::Handle
+AddressablePq<T, Arity, Key, Compare>::enqueue(const T& item, Key priority) {
+	return this->insert(priority, item);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+typename AddressablePq<T, Arity, Key, Compare>::Handle
+AddressablePq<T, Arity, Key, Compare>::enqueue(T&& item, Key priority) {
+	return this->insert(priority, std::move(item));
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+template<typename... Args>
+typename AddressablePq<T, Arity, Key, Compare>::Handle
+AddressablePq<T, Arity, Key, Compare>::emplace(Key priority, Args&&... args) {
+	return this->insert(priority, std::forward<Args>(args)...);
+}
+
+/*
+ * Reuse a freed slot when there is one, the payload is assigned over the
+ * moved-from leftover. Otherwise grow the slot vectors by one.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+template<typename... Args>
+typename AddressablePq<T, Arity, Key, Compare>::Handle
+AddressablePq<T, Arity, Key, Compare>::insert(Key key, Args&&... args) {
+	std::size_t slot;
+	if (!this->freeSlots.empty()) {
+		slot = this->freeSlots.back();
+		this->vals[slot] = T(std::forward<Args>(args)...);
+		this->freeSlots.pop_back();
+	} else {
+		slot = this->vals.size();
+		this->vals.emplace_back(std::forward<Args>(args)...);
+		this->pos.push_back(NOT_QUEUED);
+		this->generations.push_back(0);
+	}
+
+	this->keys.push_back(key);
+	this->slotAt.push_back(slot);
+	this->siftUp(this->keys.size() - 1, key, slot);
+	return Handle{slot, this->generations[slot]};
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+void AddressablePq<T, Arity, Key, Compare>::place(std::size_t idx, Key key, std::size_t slot) {
+	this->keys[idx] = key;
+	this->slotAt[idx] = slot;
+	this->pos[slot] = idx;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+void AddressablePq<T, Arity, Key, Compare>::siftUp(std::size_t hole, Key key, std::size_t slot) {
+	while (hole > 0) {
+		std::size_t parent = parentIdx<Arity>(hole);
+		if (this->comp(this->keys[parent], key)) {
+			break;
+		}
+		this->place(hole, this->keys[parent], this->slotAt[parent]);
+		hole = parent;
+	}
+	this->place(hole, key, slot);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+void AddressablePq<T, Arity, Key, Compare>::siftDown(std::size_t hole, Key key, std::size_t slot) {
+	const std::size_t limit = this->keys.size();
+
+	while (true) {
+		std::size_t first = firstChild<Arity>(hole);
+		if (first >= limit) {
+			break;
+		}
+
+		std::size_t siblings = limit - first < Arity ? limit - first : Arity;
+		std::size_t best = first +
+			BestChild<Key, Compare, Arity>::select(&this->keys[first], siblings, this->comp);
+		if (!this->comp(this->keys[best], key)) {
+			break;
+		}
+		this->place(hole, this->keys[best], this->slotAt[best]);
+		hole = best;
+	}
+	this->place(hole, key, slot);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+std::size_t AddressablePq<T, Arity, Key, Compare>::checkedIndex(Handle handle) const {
+	if (!this->contains(handle)) {
+		throw std::invalid_argument("stale AddressablePq handle");
+	}
+	return this->pos[handle.slot];
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+bool AddressablePq<T, Arity, Key, Compare>::contains(Handle handle) const {
+	return handle.slot < this->pos.size() &&
+		this->pos[handle.slot] != NOT_QUEUED &&
+		this->generations[handle.slot] == handle.generation;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+Key AddressablePq<T, Arity, Key, Compare>::keyOf(Handle handle) const {
+	return this->keys[this->checkedIndex(handle)];
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+const T& AddressablePq<T, Arity, Key, Compare>::get(Handle handle) const {
+	this->checkedIndex(handle);
+	return this->vals[handle.slot];
+}
+
+/*
+ * A key that now ranks higher than before can only need to go up, one
+ * that ranks lower can only need to go down.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+void AddressablePq<T, Arity, Key, Compare>::updateKey(Handle handle, Key priority) {
+	std::size_t idx = this->checkedIndex(handle);
+	Key old = this->keys[idx];
+	if (this->comp(priority, old)) {
+		this->siftUp(idx, priority, handle.slot);
+	} else {
+		this->siftDown(idx, priority, handle.slot);
+	}
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+T AddressablePq<T, Arity, Key, Compare>::erase(Handle handle) {
+	return this->removeAt(this->checkedIndex(handle));
+}
+
+/*
+ * Fill the gap at idx with the last entry and let it float whichever way
+ * it has to. The slot is retired and its generation bumped so any handle
+ * still pointing at it stops matching.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+T AddressablePq<T, Arity, Key, Compare>::removeAt(std::size_t idx) {
+	std::size_t slot = this->slotAt[idx];
+	T result = std::move(this->vals[slot]);
+	this->pos[slot] = NOT_QUEUED;
+	this->generations[slot]++;
+	this->freeSlots.push_back(slot);
+
+	Key lastKey = this->keys.back();
+	std::size_t lastSlot = this->slotAt.back();
+	this->keys.pop_back();
+	this->slotAt.pop_back();
+
+	if (idx < this->keys.size()) {
+		if (idx > 0 && this->comp(lastKey, this->keys[parentIdx<Arity>(idx)])) {
+			this->siftUp(idx, lastKey, lastSlot);
+		} else {
+			this->siftDown(idx, lastKey, lastSlot);
+		}
+	}
+	return result;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+T AddressablePq<T, Arity, Key, Compare>::dequeue() {
+	if (this->keys.empty()) {
+		throw std::out_of_range("dequeue on empty AddressablePq");
+	}
+	return this->removeAt(0);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+std::optional<T> AddressablePq<T, Arity, Key, Compare>::tryDequeue() {
+	if (this->keys.empty()) {
+		return std::nullopt;
+	}
+	return std::optional<T>(this->removeAt(0));
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+const T& AddressablePq<T, Arity, Key, Compare>::peek() const {
+	if (this->keys.empty()) {
+		throw std::out_of_range("peek on empty AddressablePq");
+	}
+	return this->vals[this->slotAt[0]];
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+Key AddressablePq<T, Arity, Key, Compare>::peekKey() const {
+	if (this->keys.empty()) {
+		throw std::out_of_range("peekKey on empty AddressablePq");
+	}
+	return this->keys[0];
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+int AddressablePq<T, Arity, Key, Compare>::count() const {
+	return this->keys.size();
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+bool AddressablePq<T, Arity, Key, Compare>::isEmpty() const {
+	return this->keys.empty();
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+void AddressablePq<T, Arity, Key, Compare>::reserve(std::size_t n) {
+	this->keys.reserve(n);
+	this->slotAt.reserve(n);
+	this->vals.reserve(n);
+	this->pos.reserve(n);
+	this->generations.reserve(n);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Compare>
+void AddressablePq<T, Arity, Key, Compare>::print() const {
+	for (std::size_t i = 0; i < this->keys.size(); i++) {
+		std::cout << this->keys[i] << std::endl;
+	}
+}
+
+/*
+ * ReverseOrder<Compare>::type ranks items the other way round. The
+ * standard comparators map onto each other so the SIMD child selection
+ * still applies, anything else gets wrapped.
+ */
+template<typename Compare>
+struct Reversed {
+	Compare comp;
+
+	template<typename A, typename B>
+	bool operator()(const A& a, const B& b) const {
+		return this->comp(b, a);
+	}
+};
+
+template<typename Compare>
+struct ReverseOrder {
+	typedef Reversed<Compare> type;
+	static type make(const Compare& comp) {
+		return type{comp};
+	}
+};
+
+template<typename Key>
+struct ReverseOrder<std::less<Key> > {
+	typedef std::greater<Key> type;
+	static type make(const std::less<Key>&) {
+		return type();
+	}
+};
+
+template<typename Key>
+struct ReverseOrder<std::greater<Key> > {
+	typedef std::less<Key> type;
+	static type make(const std::greater<Key>&) {
+		return type();
+	}
+};
+
+// min heap shorthand, Pq<T> stays a max heap over int keys
+template<typename T, typename Key = int, std::size_t Arity = 2>
+using MinPq = Pq<T, Arity, Key, std::less<Key> >;
+
+// key only Pq, see the Pq<void, ...> specialization below
+template<typename Key = int, std::size_t Arity = 2, typename Compare = std::greater<Key> >
+using KeyPq = Pq<void, Arity, Key, Compare>;
+
+// Pq with a stats policy, CountingStats unless ProfilingStats is asked for
+template<typename T, std::size_t Arity = 2, typename Key = int,
+	typename Compare = std::greater<Key>, typename Stats = CountingStats>
+using InstrumentedPq = Pq<T, Arity, Key, Compare, std::allocator<T>, Stats>;
+
+// Pq over a blocked layout, the default is about one 4 KiB page per block for a binary heap of ints
+template<typename T, std::size_t Arity = 2, typename Key = int,
+	typename Compare = std::greater<Key>, std::size_t Levels = 9>
+using BlockedPq = Pq<T, Arity, Key, Compare, std::allocator<T>, NoStats, BlockedLayout<Levels> >;
+
+/*
+ * MonotoneLess orders like std::less but also promises that keys are
+ * monotone: nothing is ever enqueued below the key that was dequeued
+ * last, as with event timestamps or Dijkstra distances. For unsigned
+ * integer keys that promise selects the radix heap below.
+ */
+template<typename Key>
+struct MonotoneLess : std::less<Key> {};
+
+/*
+ * Radix heap. Item keys are bucketed by the highest bit in which they
+ * differ from the last dequeued key, bucket 0 holding keys equal to it.
+ * Enqueue is O(1). Dequeue pops from bucket 0 and when that runs dry it
+ * finds the smallest key in the first non empty bucket, makes it the new
+ * last key and redistributes that bucket into strictly lower ones. An
+ * item can only move down, so across its lifetime it is touched at most
+ * once per bucket, making everything amortized O(bits of Key).
+ *
+ * Arity has no meaning here and is ignored. Enqueueing a key below the
+ * last dequeued key throws std::invalid_argument.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+class Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout> {
+	static_assert(std::is_integral<Key>::value && std::is_unsigned<Key>::value,
+		"the radix heap needs unsigned integer keys");
+	static_assert(std::is_same<Stats, NoStats>::value, "the radix heap has no stats hooks");
+	static_assert(std::is_same<Layout, ImplicitLayout>::value, "the radix heap has no tree layout");
+	// same std::vector<bool> problem as the general Pq
+	static_assert(!std::is_same<T, bool>::value, "Pq<bool> is not supported, wrap the bool");
+
+	public:
+		typedef Alloc allocator_type;
+
+		Pq() : Pq(Alloc()) {}
+		explicit Pq(const MonotoneLess<Key>&, const Alloc& alloc = Alloc()) : Pq(alloc) {}
+		explicit Pq(const Alloc& alloc);
+		template<typename InputIt>
+		Pq(InputIt first, InputIt last, const MonotoneLess<Key>& = MonotoneLess<Key>(),
+			const Alloc& alloc = Alloc());
+
+		void enqueue(const T& item, Key priority);
+		void enqueue(T&& item, Key priority);
+		template<typename... Args>
+		void emplace(Key priority, Args&&... args);
+		template<typename InputIt>
+		void enqueueBulk(InputIt first, InputIt last);
+		template<typename Range>
+		void enqueueBulk(const Range& items);
+		T dequeue();
+		std::optional<T> tryDequeue();
+		template<typename OutputIt>
+		std::size_t dequeueBatch(std::size_t k, OutputIt out);
+		const T& peek() const;
+		Key peekKey() const;
+		int count() const;
+		bool isEmpty() const;
+		// buckets grow independently, kept for interface parity
+		void reserve(std::size_t) {}
+		Alloc get_allocator() const;
+		void print() const;
+	private:
+		static constexpr std::size_t BUCKETS = std::numeric_limits<Key>::digits + 1;
+
+		typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Key> KeyAlloc;
+
+		struct Bucket {
+			std::vector<Key, KeyAlloc> keys;
+			std::vector<T, Alloc> vals;
+
+			explicit Bucket(const Alloc& alloc) : keys(KeyAlloc(alloc)), vals(alloc) {}
+		};
+
+		std::array<Bucket, BUCKETS> buckets;
+		Key last = 0;
+		std::size_t size = 0;
+
+		std::size_t bucketFor(Key key) const;
+		template<typename... Args>
+		void append(Key key, Args&&... args);
+		void settle();
+		void popFront();
+		std::pair<std::size_t, std::size_t> findFront() const;
+
+		// one Bucket(alloc) per index, std::array has no fill constructor
+		template<std::size_t... I>
+		static std::array<Bucket, BUCKETS> makeBuckets(const Alloc& alloc,
+			std::index_sequence<I...>) {
+			return {{((void)I, Bucket(alloc))...}};
+		}
+};
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::Pq(const Alloc& alloc)
+	: buckets(makeBuckets(alloc, std::make_index_sequence<BUCKETS>())) {
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+template<typename InputIt>
+Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::Pq(InputIt first, InputIt last,
+	const MonotoneLess<Key>&, const Alloc& alloc) : Pq(alloc) {
+	this->enqueueBulk(first, last);
+}
+
+// index of the highest bit where key and last differ, plus one
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+std::size_t Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::bucketFor(Key key) const {
+	unsigned long long diff = key ^ this->last;
+	if (diff == 0) {
+		return 0;
+	}
+	return std::numeric_limits<unsigned long long>::digits - __builtin_clzll(diff);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+template<typename... Args>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::append(Key key, Args&&... args) {
+	if (key < this->last) {
+		throw std::invalid_argument("radix Pq key below the last dequeued key");
+	}
+
+	Bucket& bucket = this->buckets[this->bucketFor(key)];
+	bucket.keys.push_back(key);
+	try {
+		bucket.vals.emplace_back(std::forward<Args>(args)...);
+	} catch (...) {
+		bucket.keys.pop_back();
+		throw;
+	}
+	this->size++;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::enqueue(const T& item, Key priority) {
+	this->append(priority, item);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::enqueue(T&& item, Key priority) {
+	this->append(priority, std::move(item));
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+template<typename... Args>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::emplace(Key priority, Args&&... args) {
+	this->append(priority, std::forward<Args>(args)...);
+}
+
+// every insert is O(1) already, so bulk is just a loop
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+template<typename InputIt>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::enqueueBulk(InputIt first, InputIt last) {
+	for (; first != last; ++first) {
+		auto&& entry = *first;
+		this->append(entry.second, std::forward<decltype(entry)>(entry).first);
+	}
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+template<typename Range>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::enqueueBulk(const Range& items) {
+	this->enqueueBulk(std::begin(items), std::end(items));
+}
+
+/*
+ * Make sure bucket 0 holds the minimum. Everything in the first non empty
+ * bucket agrees with last above that bucket's bit, so re-bucketing it
+ * against its own minimum sends every item to a strictly lower bucket.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::settle() {
+	if (!this->buckets[0].keys.empty()) {
+		return;
+	}
+
+	std::size_t i = 1;
+	while (this->buckets[i].keys.empty()) {
+		i++;
+	}
+
+	Bucket& from = this->buckets[i];
+	Key minKey = from.keys[0];
+	for (std::size_t j = 1; j < from.keys.size(); j++) {
+		if (from.keys[j] < minKey) {
+			minKey = from.keys[j];
+		}
+	}
+
+	this->last = minKey;
+	for (std::size_t j = 0; j < from.keys.size(); j++) {
+		Bucket& to = this->buckets[this->bucketFor(from.keys[j])];
+		to.keys.push_back(from.keys[j]);
+		to.vals.push_back(std::move(from.vals[j]));
+	}
+	// clear keeps the capacity around for the next time this bucket fills
+	from.keys.clear();
+	from.vals.clear();
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::popFront() {
+	this->buckets[0].keys.pop_back();
+	this->buckets[0].vals.pop_back();
+	this->size--;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+T Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::dequeue() {
+	if (this->size == 0) {
+		throw std::out_of_range("dequeue on empty Pq");
+	}
+
+	this->settle();
+	T result = std::move(this->buckets[0].vals.back());
+	this->popFront();
+	return result;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+std::optional<T> Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::tryDequeue() {
+	if (this->size == 0) {
+		return std::nullopt;
+	}
+
+	this->settle();
+	std::optional<T> result(std::move(this->buckets[0].vals.back()));
+	this->popFront();
+	return result;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+template<typename OutputIt>
+std::size_t Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::dequeueBatch(std::size_t k, OutputIt out) {
+	std::size_t n = k < this->size ? k : this->size;
+	for (std::size_t i = 0; i < n; i++) {
+		this->settle();
+		*out = std::move(this->buckets[0].vals.back());
+		++out;
+		this->popFront();
+	}
+	return n;
+}
+
+/*
+ * peek does not redistribute, it scans the first non empty bucket for
+ * its minimum. Moving last forward here would start rejecting keys that
+ * are still legal because nothing at that key has been dequeued yet.
+ * Returns the bucket and the index in it of the item dequeue hands out.
+ */
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+std::pair<std::size_t, std::size_t> Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::findFront() const {
+	std::size_t i = 0;
+	while (this->buckets[i].keys.empty()) {
+		i++;
+	}
+
+	const Bucket& bucket = this->buckets[i];
+	// last occurrence of the minimum, the one dequeue will hand out
+	std::size_t best = 0;
+	for (std::size_t j = 1; j < bucket.keys.size(); j++) {
+		if (bucket.keys[j] <= bucket.keys[best]) {
+			best = j;
+		}
+	}
+	return std::make_pair(i, best);
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+const T& Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::peek() const {
+	if (this->size == 0) {
+		throw std::out_of_range("peek on empty Pq");
+	}
+	std::pair<std::size_t, std::size_t> front = this->findFront();
+	return this->buckets[front.first].vals[front.second];
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+Key Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::peekKey() const {
+	if (this->size == 0) {
+		throw std::out_of_range("peekKey on empty Pq");
+	}
+	std::pair<std::size_t, std::size_t> front = this->findFront();
+	return this->buckets[front.first].keys[front.second];
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+int Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::count() const {
+	return this->size;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+bool Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::isEmpty() const {
+	return this->size == 0;
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+Alloc Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::get_allocator() const {
+	return this->buckets[0].vals.get_allocator();
+}
+
+template<typename T, std::size_t Arity, typename Key, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<T, Arity, Key, MonotoneLess<Key>, Alloc, Stats, Layout>::print() const {
+	for (std::size_t i = 0; i < BUCKETS; i++) {
+		for (std::size_t j = 0; j < this->buckets[i].keys.size(); j++) {
+			std::cout << this->buckets[i].keys[j] << std::endl;
+		}
+	}
+}
+
+
+/*
+ * Key only Pq. When the key is all there is to an item, as when sorting
+ * numbers, Pq<T, ...> with T = Key stores every value twice. With T =
+ * void there is no payload: the heap is the one key vector, enqueue
+ * takes just the key and dequeue returns it. A queue of ints takes 4
+ * bytes per item instead of 8, and sifts move half the data. Arity,
+ * Compare, Stats and Layout work as in Pq. Alloc is rebound to Key, so
+ * the default std::allocator<void> or an allocator for Key both work.
+ * For a small payload next to the key, see PackedPq in packed_pq.hh.
+ */
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+class Pq<void, Arity, Key, Compare, Alloc, Stats, Layout> : private Stats {
+	static_assert(Arity >= 2, "a heap needs at least two children per node");
+	// peek() returns a reference into a std::vector<Key>
+	static_assert(!std::is_same<Key, bool>::value, "bool keys are not supported");
+
+	public:
+		typedef Alloc allocator_type;
+
+		Pq() = default;
+		explicit Pq(const Compare& comp, const Alloc& alloc = Alloc());
+		explicit Pq(const Alloc& alloc);
+		// build from keys in O(n) with Floyd's heapify
+		template<typename InputIt>
+		Pq(InputIt first, InputIt last, const Compare& comp = Compare(),
+			const Alloc& alloc = Alloc());
+
+		void enqueue(Key key);
+		// append keys then restore the heap bottom up
+		template<typename InputIt>
+		void enqueueBulk(InputIt first, InputIt last);
+		template<typename Range>
+		void enqueueBulk(const Range& keys);
+		// throws std::out_of_range when empty
+		Key dequeue();
+		std::optional<Key> tryDequeue();
+		template<typename OutputIt>
+		std::size_t dequeueBatch(std::size_t k, OutputIt out);
+		void replaceTop(Key key);
+		const Key& peek() const;
+		Key peekKey() const;
+		int count() const;
+		bool isEmpty() const;
+		void reserve(std::size_t n);
+		Alloc get_allocator() const;
+		PqStatsSnapshot stats() const;
+		void resetStats();
+		void print() const;
+		void dump(std::ostream& os, std::size_t levels = 6, std::size_t perLevel = 8) const;
+	private:
+		typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Key> KeyAlloc;
+
+		std::vector<Key, KeyAlloc> keys;
+		Compare comp;
+
+		void siftUp(std::size_t hole);
+		void siftDown(std::size_t hole, Key key);
+		void heapifyFrom(std::size_t lo);
+		void popRoot();
+};
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::Pq(const Compare& comp, const Alloc& alloc)
+	: keys(KeyAlloc(alloc)), comp(comp) {
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::Pq(const Alloc& alloc)
+	: keys(KeyAlloc(alloc)) {
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+template<typename InputIt>
+Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::Pq(InputIt first, InputIt last, const Compare& comp,
+	const Alloc& alloc)
+	: keys(KeyAlloc(alloc)), comp(comp) {
+	this->enqueueBulk(first, last);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::enqueue(Key key) {
+	typename Stats::Timer timer = this->statStart();
+	this->keys.push_back(key);
+	this->siftUp(this->keys.size() - 1);
+	this->statFinish(PqOp::ENQUEUE, timer);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+template<typename InputIt>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::enqueueBulk(InputIt first, InputIt last) {
+	using Category = typename std::iterator_traits<InputIt>::iterator_category;
+	if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value) {
+		std::size_t needed = this->keys.size() + std::distance(first, last);
+		if (needed > this->keys.capacity()) {
+			std::size_t doubled = 2 * this->keys.capacity();
+			this->reserve(needed > doubled ? needed : doubled);
+		}
+	}
+
+	std::size_t lo = this->keys.size();
+	for (; first != last; ++first) {
+		this->keys.push_back(*first);
+	}
+	this->heapifyFrom(lo);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+template<typename Range>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::enqueueBulk(const Range& keys) {
+	this->enqueueBulk(std::begin(keys), std::end(keys));
+}
+
+// same walk as Pq::heapifyFrom without the payloads
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::heapifyFrom(std::size_t lo) {
+	const std::size_t n = this->keys.size();
+	if (n < 2 || lo >= n) {
+		return;
+	}
+
+	if constexpr (!Layout::LEVEL_ORDER) {
+		if (lo > 0 && n - lo < lo) {
+			for (std::size_t i = lo; i < n; i++) {
+				this->siftUp(i);
+			}
+			return;
+		}
+		for (std::size_t i = n; i-- > 0;) {
+			if (Layout::template child<Arity>(i) < n) {
+				this->siftDown(i, this->keys[i]);
+			}
+		}
+		return;
+	}
+
+	std::size_t hi = parentIdx<Arity>(n - 1);
+	lo = lo == 0 ? 0 : parentIdx<Arity>(lo);
+	while (true) {
+		for (std::size_t i = hi + 1; i-- > lo;) {
+			this->siftDown(i, this->keys[i]);
+		}
+		if (lo == 0) {
+			break;
+		}
+		lo = parentIdx<Arity>(lo);
+		hi = parentIdx<Arity>(hi);
+	}
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::siftUp(std::size_t hole) {
+	const Key key = this->keys[hole];
+	std::size_t levels = 0;
+	std::size_t compares = 0;
+	while (hole > 0) {
+		std::size_t parent = Layout::template parent<Arity>(hole);
+		compares++;
+		if (this->comp(this->keys[parent], key)) {
+			break;
+		}
+		this->keys[hole] = this->keys[parent];
+		hole = parent;
+		levels++;
+	}
+	this->keys[hole] = key;
+
+	this->statCompares(compares);
+	this->statMoves(levels);
+	this->statSiftUp(levels);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::siftDown(std::size_t hole, Key key) {
+	const std::size_t limit = this->keys.size();
+	std::size_t levels = 0;
+	std::size_t compares = 0;
+
+	while (true) {
+		std::size_t first = Layout::template child<Arity>(hole);
+		if (first >= limit) {
+			break;
+		}
+
+		std::size_t siblings = limit - first < Arity ? limit - first : Arity;
+		std::size_t best = first +
+			BestChild<Key, Compare, Arity>::select(&this->keys[first], siblings, this->comp);
+		compares += siblings;
+
+		if (!this->comp(this->keys[best], key)) {
+			break;
+		}
+		this->keys[hole] = this->keys[best];
+		hole = best;
+		levels++;
+	}
+	this->keys[hole] = key;
+
+	this->statCompares(compares);
+	this->statMoves(levels);
+	this->statSiftDown(levels);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::popRoot() {
+	Key last = this->keys.back();
+	this->keys.pop_back();
+	if (!this->keys.empty()) {
+		this->siftDown(0, last);
+	}
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+Key Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::dequeue() {
+	if (this->keys.empty()) {
+		throw std::out_of_range("dequeue on empty Pq");
+	}
+
+	typename Stats::Timer timer = this->statStart();
+	Key result = this->keys[0];
+	this->popRoot();
+	this->statFinish(PqOp::DEQUEUE, timer);
+	return result;
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+std::optional<Key> Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::tryDequeue() {
+	if (this->keys.empty()) {
+		return std::nullopt;
+	}
+	return this->dequeue();
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+template<typename OutputIt>
+std::size_t Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::dequeueBatch(std::size_t k, OutputIt out) {
+	std::size_t n = k < this->keys.size() ? k : this->keys.size();
+	for (std::size_t i = 0; i < n; i++) {
+		typename Stats::Timer timer = this->statStart();
+		*out = this->keys[0];
+		++out;
+		this->popRoot();
+		this->statFinish(PqOp::DEQUEUE, timer);
+	}
+	return n;
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::replaceTop(Key key) {
+	if (this->keys.empty()) {
+		throw std::out_of_range("replaceTop on empty Pq");
+	}
+	typename Stats::Timer timer = this->statStart();
+	this->siftDown(0, key);
+	this->statFinish(PqOp::REPLACE_TOP, timer);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+const Key& Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::peek() const {
+	if (this->keys.empty()) {
+		throw std::out_of_range("peek on empty Pq");
+	}
+	return this->keys[0];
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+Key Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::peekKey() const {
+	if (this->keys.empty()) {
+		throw std::out_of_range("peekKey on empty Pq");
+	}
+	return this->keys[0];
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+int Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::count() const {
+	return this->keys.size();
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+bool Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::isEmpty() const {
+	return this->keys.empty();
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::reserve(std::size_t n) {
+	this->keys.reserve(n);
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+Alloc Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::get_allocator() const {
+	return Alloc(this->keys.get_allocator());
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+PqStatsSnapshot Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::stats() const {
+	return this->statSnapshot();
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::resetStats() {
+	this->statReset();
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::print() const {
+	for (std::size_t i = 0; i < this->keys.size(); i++) {
+		std::cout << this->keys[i] << std::endl;
+	}
+}
+
+template<std::size_t Arity, typename Key, typename Compare, typename Alloc, typename Stats,
+	typename Layout>
+void Pq<void, Arity, Key, Compare, Alloc, Stats, Layout>::dump(std::ostream& os, std::size_t levels,
+	std::size_t perLevel) const {
+	os << "Pq size " << this->keys.size() << " arity " << Arity << "\n";
+	dumpLevels<Arity, Layout>(os, this->keys.data(), this->keys.size(), levels, perLevel);
+}
+
 #endif
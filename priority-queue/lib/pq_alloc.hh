@@ -0,0 +1,363 @@
+#ifndef PQ_ALLOC_H
+
+#define PQ_ALLOC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <pq.hh>
+
+/*
+ * Memory resources for running Pq, or anything else that takes a
+ * std::pmr::polymorphic_allocator, off the global heap.
+ *
+ * ArenaResource is a monotonic bump allocator over one block. deallocate
+ * does nothing and reset() rewinds the whole arena at once. A queue that
+ * is built and drained within one request allocates from the arena and
+ * the arena is reset between requests. If a request outgrows the block
+ * the overflow comes from upstream, and the next reset() regrows the
+ * block to fit, so the steady state makes no upstream calls at all.
+ *
+ * PoolResource hands out fixed size blocks from a free list carved out
+ * of larger slabs. Anything up to the block size takes one block, bigger
+ * or over aligned requests go upstream. Freed blocks are reused straight
+ * away, which suits queues that reserve() a known capacity and live
+ * longer than one request.
+ *
+ * CountingResource forwards to an upstream resource and counts what goes
+ * through. Put one under an arena or pool to see how often it falls back.
+ *
+ * ArenaResource and PoolResource do not lock, give each thread its own.
+ * CountingResource uses atomics and can be shared.
+ */
+
+template<typename T, std::size_t Arity = 2, typename Key = int,
+	typename Compare = std::greater<Key> >
+using PmrPq = Pq<T, Arity, Key, Compare, std::pmr::polymorphic_allocator<T> >;
+
+struct AllocStats {
+	std::size_t allocations;
+	std::size_t deallocations;
+	// total bytes ever requested
+	std::size_t bytes;
+	std::size_t liveBytes;
+	std::size_t peakBytes;
+};
+
+class CountingResource : public std::pmr::memory_resource {
+	public:
+		explicit CountingResource(
+			std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+		AllocStats stats() const;
+		void resetStats();
+	private:
+		std::pmr::memory_resource* upstream;
+		std::atomic<std::size_t> allocations{0};
+		std::atomic<std::size_t> deallocations{0};
+		std::atomic<std::size_t> bytes{0};
+		std::atomic<std::size_t> liveBytes{0};
+		std::atomic<std::size_t> peakBytes{0};
+
+		void* do_allocate(std::size_t size, std::size_t align) override;
+		void do_deallocate(void* p, std::size_t size, std::size_t align) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+inline CountingResource::CountingResource(std::pmr::memory_resource* upstream)
+	: upstream(upstream) {
+}
+
+inline void* CountingResource::do_allocate(std::size_t size, std::size_t align) {
+	void* p = this->upstream->allocate(size, align);
+	this->allocations.fetch_add(1, std::memory_order_relaxed);
+	this->bytes.fetch_add(size, std::memory_order_relaxed);
+	std::size_t live = this->liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	std::size_t peak = this->peakBytes.load(std::memory_order_relaxed);
+	while (live > peak &&
+		!this->peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+	return p;
+}
+
+inline void CountingResource::do_deallocate(void* p, std::size_t size, std::size_t align) {
+	this->upstream->deallocate(p, size, align);
+	this->deallocations.fetch_add(1, std::memory_order_relaxed);
+	this->liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+inline bool CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+inline AllocStats CountingResource::stats() const {
+	AllocStats out;
+	out.allocations = this->allocations.load(std::memory_order_relaxed);
+	out.deallocations = this->deallocations.load(std::memory_order_relaxed);
+	out.bytes = this->bytes.load(std::memory_order_relaxed);
+	out.liveBytes = this->liveBytes.load(std::memory_order_relaxed);
+	out.peakBytes = this->peakBytes.load(std::memory_order_relaxed);
+	return out;
+}
+
+// live bytes are still outstanding, so they carry over as the new peak
+inline void CountingResource::resetStats() {
+	this->allocations.store(0, std::memory_order_relaxed);
+	this->deallocations.store(0, std::memory_order_relaxed);
+	this->bytes.store(0, std::memory_order_relaxed);
+	this->peakBytes.store(this->liveBytes.load(std::memory_order_relaxed),
+		std::memory_order_relaxed);
+}
+
+class ArenaResource : public std::pmr::memory_resource {
+	public:
+		// owns a block of capacity bytes taken from upstream
+		explicit ArenaResource(std::size_t capacity,
+			std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+		// bumps through a caller owned buffer, which is never regrown
+		ArenaResource(void* buffer, std::size_t capacity,
+			std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+		~ArenaResource();
+
+		ArenaResource(const ArenaResource&) = delete;
+		ArenaResource& operator=(const ArenaResource&) = delete;
+
+		// everything handed out since the last reset becomes invalid
+		void reset();
+		std::size_t capacity() const;
+		// bytes handed out since the last reset, overflow included
+		std::size_t used() const;
+		// upstream chunks taken since the last reset
+		std::size_t overflows() const;
+	private:
+		struct Chunk {
+			Chunk* next;
+			std::size_t size;
+		};
+
+		std::pmr::memory_resource* upstream;
+		char* base;
+		std::size_t cap;
+		bool owned;
+		char* cur;
+		char* end;
+		Chunk* chunks = nullptr;
+		std::size_t chunkCount = 0;
+		std::size_t usedBytes = 0;
+
+		void* do_allocate(std::size_t size, std::size_t align) override;
+		void do_deallocate(void*, std::size_t, std::size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+		void freeChunks();
+};
+
+inline ArenaResource::ArenaResource(std::size_t capacity, std::pmr::memory_resource* upstream)
+	: upstream(upstream),
+	base(static_cast<char*>(upstream->allocate(capacity, alignof(std::max_align_t)))),
+	cap(capacity), owned(true), cur(base), end(base + capacity) {
+}
+
+inline ArenaResource::ArenaResource(void* buffer, std::size_t capacity,
+	std::pmr::memory_resource* upstream)
+	: upstream(upstream), base(static_cast<char*>(buffer)), cap(capacity), owned(false),
+	cur(base), end(base + capacity) {
+}
+
+inline ArenaResource::~ArenaResource() {
+	this->freeChunks();
+	if (this->owned) {
+		this->upstream->deallocate(this->base, this->cap, alignof(std::max_align_t));
+	}
+}
+
+inline void* ArenaResource::do_allocate(std::size_t size, std::size_t align) {
+	std::size_t pad = -reinterpret_cast<std::uintptr_t>(this->cur) & (align - 1);
+	if (pad + size > static_cast<std::size_t>(this->end - this->cur)) {
+		// start a new chunk at least twice the last one, the header goes first
+		std::size_t last = this->chunks ? this->chunks->size : this->cap;
+		std::size_t want = sizeof(Chunk) + align + size;
+		std::size_t chunkSize = 2 * last > want ? 2 * last : want;
+		Chunk* chunk = static_cast<Chunk*>(
+			this->upstream->allocate(chunkSize, alignof(std::max_align_t)));
+		chunk->next = this->chunks;
+		chunk->size = chunkSize;
+		this->chunks = chunk;
+		this->chunkCount++;
+		this->cur = reinterpret_cast<char*>(chunk + 1);
+		this->end = reinterpret_cast<char*>(chunk) + chunkSize;
+		pad = -reinterpret_cast<std::uintptr_t>(this->cur) & (align - 1);
+	}
+
+	char* p = this->cur + pad;
+	this->cur = p + size;
+	this->usedBytes += pad + size;
+	return p;
+}
+
+inline bool ArenaResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+inline void ArenaResource::freeChunks() {
+	while (this->chunks) {
+		Chunk* next = this->chunks->next;
+		this->upstream->deallocate(this->chunks, this->chunks->size, alignof(std::max_align_t));
+		this->chunks = next;
+	}
+	this->chunkCount = 0;
+}
+
+/*
+ * If the last round overflowed, an owned block is replaced by one big
+ * enough for everything that round used, so a workload of steady size
+ * stops overflowing after its first reset.
+ */
+inline void ArenaResource::reset() {
+	bool overflowed = this->chunks != nullptr;
+	this->freeChunks();
+	if (overflowed && this->owned) {
+		std::size_t grown = this->usedBytes + this->usedBytes / 4;
+		char* fresh = static_cast<char*>(this->upstream->allocate(grown, alignof(std::max_align_t)));
+		this->upstream->deallocate(this->base, this->cap, alignof(std::max_align_t));
+		this->base = fresh;
+		this->cap = grown;
+	}
+	this->cur = this->base;
+	this->end = this->base + this->cap;
+	this->usedBytes = 0;
+}
+
+inline std::size_t ArenaResource::capacity() const {
+	return this->cap;
+}
+
+inline std::size_t ArenaResource::used() const {
+	return this->usedBytes;
+}
+
+inline std::size_t ArenaResource::overflows() const {
+	return this->chunkCount;
+}
+
+class PoolResource : public std::pmr::memory_resource {
+	public:
+		explicit PoolResource(std::size_t blockSize, std::size_t blocksPerSlab = 64,
+			std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+		~PoolResource();
+
+		PoolResource(const PoolResource&) = delete;
+		PoolResource& operator=(const PoolResource&) = delete;
+
+		std::size_t blockSize() const;
+		std::size_t blocksInUse() const;
+		// slabs taken from upstream so far
+		std::size_t slabCount() const;
+	private:
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		// slab header, padded so the blocks after it stay max aligned
+		struct alignas(std::max_align_t) Slab {
+			Slab* next;
+		};
+
+		std::pmr::memory_resource* upstream;
+		std::size_t block;
+		std::size_t perSlab;
+		FreeBlock* freeList = nullptr;
+		Slab* slabs = nullptr;
+		std::size_t slabTotal = 0;
+		std::size_t inUse = 0;
+
+		void* do_allocate(std::size_t size, std::size_t align) override;
+		void do_deallocate(void* p, std::size_t size, std::size_t align) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+		bool fits(std::size_t size, std::size_t align) const;
+		void grow();
+};
+
+// block size is rounded up so every block stays max aligned
+inline PoolResource::PoolResource(std::size_t blockSize, std::size_t blocksPerSlab,
+	std::pmr::memory_resource* upstream)
+	: upstream(upstream),
+	block((blockSize + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1)),
+	perSlab(blocksPerSlab == 0 ? 1 : blocksPerSlab) {
+	if (this->block < sizeof(FreeBlock)) {
+		this->block = alignof(std::max_align_t);
+	}
+}
+
+inline PoolResource::~PoolResource() {
+	while (this->slabs) {
+		Slab* next = this->slabs->next;
+		this->upstream->deallocate(this->slabs, sizeof(Slab) + this->block * this->perSlab,
+			alignof(Slab));
+		this->slabs = next;
+	}
+}
+
+inline bool PoolResource::fits(std::size_t size, std::size_t align) const {
+	return size <= this->block && align <= alignof(std::max_align_t);
+}
+
+inline void PoolResource::grow() {
+	Slab* slab = static_cast<Slab*>(
+		this->upstream->allocate(sizeof(Slab) + this->block * this->perSlab, alignof(Slab)));
+	slab->next = this->slabs;
+	this->slabs = slab;
+	this->slabTotal++;
+
+	// thread the new blocks onto the free list back to front so they go out in address order
+	char* blocks = reinterpret_cast<char*>(slab + 1);
+	for (std::size_t i = this->perSlab; i-- > 0;) {
+		FreeBlock* b = reinterpret_cast<FreeBlock*>(blocks + i * this->block);
+		b->next = this->freeList;
+		this->freeList = b;
+	}
+}
+
+inline void* PoolResource::do_allocate(std::size_t size, std::size_t align) {
+	if (!this->fits(size, align)) {
+		return this->upstream->allocate(size, align);
+	}
+	if (!this->freeList) {
+		this->grow();
+	}
+	FreeBlock* b = this->freeList;
+	this->freeList = b->next;
+	this->inUse++;
+	return b;
+}
+
+inline void PoolResource::do_deallocate(void* p, std::size_t size, std::size_t align) {
+	if (!this->fits(size, align)) {
+		this->upstream->deallocate(p, size, align);
+		return;
+	}
+	FreeBlock* b = static_cast<FreeBlock*>(p);
+	b->next = this->freeList;
+	this->freeList = b;
+	this->inUse--;
+}
+
+inline bool PoolResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+inline std::size_t PoolResource::blockSize() const {
+	return this->block;
+}
+
+inline std::size_t PoolResource::blocksInUse() const {
+	return this->inUse;
+}
+
+inline std::size_t PoolResource::slabCount() const {
+	return this->slabTotal;
+}
+
+#endif
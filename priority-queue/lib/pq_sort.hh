@@ -0,0 +1,174 @@
+#ifndef PQ_SORT_H
+
+#define PQ_SORT_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <loser_tree.hh>
+#include <pq.hh>
+
+/*
+ * Sorting built on the heap machinery in pq.hh. Both entry points sort
+ * ascending under comp, the same contract as std::sort.
+ *
+ * heapSort is an in-place 4-ary heapsort. It never allocates. On
+ * contiguous int ranges the child selection goes through the same SIMD
+ * BestChild kernels Pq uses.
+ *
+ * pqSort cuts the range into runs of about SORT_RUN elements, small
+ * enough for a heapsort to stay in L2, and heapsorts them spread over the
+ * threads. A LoserTree then merges the sorted runs on the calling thread,
+ * moving elements out of the runs, so even for a std::string nothing is
+ * copied. The merge needs one buffer the size of the input. A range of one run
+ * is just heapSorted. Past a few million elements this is several times
+ * faster than one heapSort over the whole range, even on one thread,
+ * because the big heap misses cache on every level.
+ */
+
+const std::size_t SORT_ARITY = 4;
+
+// below this many elements per thread spawning threads is not worth it
+const std::size_t PARALLEL_SORT_MIN_CHUNK = 1 << 14;
+
+// elements per heapsorted run in pqSort, 256 KiB of ints
+const std::size_t SORT_RUN = 1 << 16;
+
+template<typename It>
+struct IsVectorIterator : std::is_same<It,
+	typename std::vector<typename std::iterator_traits<It>::value_type>::iterator> {};
+
+template<typename It, typename Order>
+void heapSortSiftDown(It first, std::size_t hole, std::size_t limit,
+	typename std::iterator_traits<It>::value_type&& val, const Order& order) {
+	typedef typename std::iterator_traits<It>::value_type V;
+
+	while (true) {
+		std::size_t child = firstChild<SORT_ARITY>(hole);
+		if (child >= limit) {
+			break;
+		}
+
+		std::size_t siblings = limit - child < SORT_ARITY ? limit - child : SORT_ARITY;
+		std::size_t best = child;
+		if constexpr (std::is_pointer<It>::value) {
+			best += BestChild<V, Order, SORT_ARITY>::select(first + child, siblings, order);
+		} else {
+			for (std::size_t i = 1; i < siblings; i++) {
+				if (order(first[child + i], first[best])) {
+					best = child + i;
+				}
+			}
+		}
+
+		if (!order(first[best], val)) {
+			break;
+		}
+		first[hole] = std::move(first[best]);
+		hole = best;
+	}
+	first[hole] = std::move(val);
+}
+
+/*
+ * Build a heap whose top is the largest element under comp, then keep
+ * swapping the top behind the shrinking heap.
+ */
+template<typename It, typename Compare>
+void heapSortRange(It first, std::size_t n, const Compare& comp) {
+	typedef typename std::iterator_traits<It>::value_type V;
+	typename ReverseOrder<Compare>::type order = ReverseOrder<Compare>::make(comp);
+
+	for (std::size_t i = parentIdx<SORT_ARITY>(n - 1) + 1; i-- > 0;) {
+		V val = std::move(first[i]);
+		heapSortSiftDown(first, i, n, std::move(val), order);
+	}
+
+	for (std::size_t end = n - 1; end > 0; end--) {
+		V val = std::move(first[end]);
+		first[end] = std::move(first[0]);
+		heapSortSiftDown(first, 0, end, std::move(val), order);
+	}
+}
+
+template<typename RandomIt,
+	typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type> >
+void heapSort(RandomIt first, RandomIt last, Compare comp = Compare()) {
+	std::size_t n = last - first;
+	if (n < 2) {
+		return;
+	}
+
+	// vector storage is contiguous, hand raw pointers down so SIMD can kick in
+	if constexpr (IsVectorIterator<RandomIt>::value) {
+		heapSortRange(&*first, n, comp);
+	} else {
+		heapSortRange(first, n, comp);
+	}
+}
+
+template<typename RandomIt,
+	typename Compare = std::less<typename std::iterator_traits<RandomIt>::value_type> >
+void pqSort(RandomIt first, RandomIt last,
+	std::size_t threads = std::thread::hardware_concurrency(), Compare comp = Compare()) {
+	typedef typename std::iterator_traits<RandomIt>::value_type V;
+
+	std::size_t n = last - first;
+	std::size_t runs = (n + SORT_RUN - 1) / SORT_RUN;
+	if (runs <= 1) {
+		heapSort(first, last, comp);
+		return;
+	}
+	if (threads > n / PARALLEL_SORT_MIN_CHUNK) {
+		threads = n / PARALLEL_SORT_MIN_CHUNK;
+	}
+	if (threads > runs) {
+		threads = runs;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	std::vector<std::size_t> bounds(runs + 1);
+	for (std::size_t i = 0; i <= runs; i++) {
+		bounds[i] = n * i / runs;
+	}
+
+	// thread t takes runs t, t + threads, ...
+	auto sortRuns = [first, &bounds, &comp, runs, threads](std::size_t t) {
+		for (std::size_t r = t; r < runs; r += threads) {
+			heapSort(first + bounds[r], first + bounds[r + 1], comp);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (std::size_t t = 1; t < threads; t++) {
+		workers.emplace_back(sortRuns, t);
+	}
+	sortRuns(0);
+	for (std::thread& w : workers) {
+		w.join();
+	}
+
+	// the runs are scratch from here on, so the merge moves out of them
+	typedef std::move_iterator<RandomIt> MoveIt;
+	std::vector<typename LoserTree<MoveIt, Compare>::Range> ranges;
+	ranges.reserve(runs);
+	for (std::size_t r = 0; r < runs; r++) {
+		ranges.emplace_back(std::make_move_iterator(first + bounds[r]),
+			std::make_move_iterator(first + bounds[r + 1]));
+	}
+	std::vector<V> out;
+	out.reserve(n);
+	LoserTree<MoveIt, Compare> tree(ranges, comp);
+	tree.drainInto(std::back_inserter(out));
+
+	for (std::size_t i = 0; i < n; i++) {
+		first[i] = std::move(out[i]);
+	}
+}
+
+#endif
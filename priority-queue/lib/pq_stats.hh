@@ -0,0 +1,176 @@
+#ifndef PQ_STATS_H
+
+#define PQ_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Stats policies for Pq, picked at compile time through its Stats
+ * template parameter. Pq inherits the policy privately and calls its
+ * hooks from the sift loops and the public operations:
+ *
+ *   NoStats        the default. Every hook is empty and the policy is an
+ *                  empty base, so the queue compiles to the same code as
+ *                  without any instrumentation.
+ *   CountingStats  counts comparisons, element moves and sift depths.
+ *   ProfilingStats everything CountingStats does plus a log2 latency
+ *                  histogram per operation, at the price of two clock
+ *                  reads per operation.
+ *
+ * Sifts are hole based, so they move elements rather than swapping them.
+ * One move shifts one key and payload a level and costs about a third of
+ * a swap. A sibling group of s children costs s comparisons, s - 1 to
+ * pick the best child and one against the item being sifted, whether or
+ * not SIMD does the picking.
+ */
+
+enum class PqOp {
+	ENQUEUE,
+	DEQUEUE,
+	REPLACE_TOP,
+};
+
+const std::size_t PQ_OPS = 3;
+
+struct LatencyHistogram {
+	// bucket i counts operations that took [2^i, 2^(i+1)) ns, 0 ns lands in 0
+	static constexpr std::size_t BUCKETS = 40;
+
+	std::uint64_t buckets[BUCKETS];
+	std::uint64_t count;
+	std::uint64_t totalNs;
+
+	void record(std::uint64_t ns);
+	// upper edge in ns of the bucket holding quantile q, 0 when empty
+	std::uint64_t percentile(double q) const;
+	double meanNs() const;
+	void merge(const LatencyHistogram& other);
+};
+
+inline void LatencyHistogram::record(std::uint64_t ns) {
+	std::size_t bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+	this->buckets[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+	this->count++;
+	this->totalNs += ns;
+}
+
+inline std::uint64_t LatencyHistogram::percentile(double q) const {
+	if (this->count == 0) {
+		return 0;
+	}
+	std::uint64_t rank = q * (this->count - 1);
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < BUCKETS; i++) {
+		seen += this->buckets[i];
+		if (seen > rank) {
+			return (std::uint64_t(2) << i) - 1;
+		}
+	}
+	return (std::uint64_t(2) << (BUCKETS - 1)) - 1;
+}
+
+inline double LatencyHistogram::meanNs() const {
+	return this->count == 0 ? 0 : static_cast<double>(this->totalNs) / this->count;
+}
+
+inline void LatencyHistogram::merge(const LatencyHistogram& other) {
+	for (std::size_t i = 0; i < BUCKETS; i++) {
+		this->buckets[i] += other.buckets[i];
+	}
+	this->count += other.count;
+	this->totalNs += other.totalNs;
+}
+
+// plain data so it can be copied out and scraped, value initialize to zero
+struct PqStatsSnapshot {
+	std::uint64_t compares;
+	std::uint64_t moves;
+	std::uint64_t siftUps;
+	std::uint64_t siftUpLevels;
+	std::uint64_t maxSiftUp;
+	std::uint64_t siftDowns;
+	std::uint64_t siftDownLevels;
+	std::uint64_t maxSiftDown;
+	// indexed by PqOp, all zero unless the policy times operations
+	LatencyHistogram latency[PQ_OPS];
+
+	const LatencyHistogram& of(PqOp op) const {
+		return this->latency[static_cast<std::size_t>(op)];
+	}
+};
+
+struct NoStats {
+	struct Timer {};
+
+	void statCompares(std::size_t) {}
+	void statMoves(std::size_t) {}
+	void statSiftUp(std::size_t) {}
+	void statSiftDown(std::size_t) {}
+	Timer statStart() const {
+		return Timer();
+	}
+	void statFinish(PqOp, Timer) {}
+	PqStatsSnapshot statSnapshot() const {
+		return PqStatsSnapshot();
+	}
+	void statReset() {}
+};
+
+class CountingStats {
+	public:
+		struct Timer {};
+
+		void statCompares(std::size_t n) {
+			this->snap.compares += n;
+		}
+
+		void statMoves(std::size_t n) {
+			this->snap.moves += n;
+		}
+
+		void statSiftUp(std::size_t levels) {
+			this->snap.siftUps++;
+			this->snap.siftUpLevels += levels;
+			this->snap.maxSiftUp = levels > this->snap.maxSiftUp ? levels : this->snap.maxSiftUp;
+		}
+
+		void statSiftDown(std::size_t levels) {
+			this->snap.siftDowns++;
+			this->snap.siftDownLevels += levels;
+			this->snap.maxSiftDown = levels > this->snap.maxSiftDown ? levels : this->snap.maxSiftDown;
+		}
+
+		Timer statStart() const {
+			return Timer();
+		}
+
+		void statFinish(PqOp, Timer) {}
+
+		PqStatsSnapshot statSnapshot() const {
+			return this->snap;
+		}
+
+		void statReset() {
+			this->snap = PqStatsSnapshot();
+		}
+	protected:
+		PqStatsSnapshot snap = PqStatsSnapshot();
+};
+
+class ProfilingStats : public CountingStats {
+	public:
+		typedef std::chrono::steady_clock::time_point Timer;
+
+		Timer statStart() const {
+			return std::chrono::steady_clock::now();
+		}
+
+		void statFinish(PqOp op, Timer start) {
+			std::chrono::nanoseconds took = std::chrono::steady_clock::now() - start;
+			this->snap.latency[static_cast<std::size_t>(op)].record(took.count());
+		}
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef TOP_K_H
+
+#define TOP_K_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <pq.hh>
+
+/*
+ * TopK keeps the k best items of a stream under Compare, std::greater
+ * (the highest keys) by default. It is a Pq of capacity k ordered the
+ * other way round, so the worst kept item sits at the root and its key is
+ * the threshold a newcomer has to beat.
+ *
+ * - Once full, offer() rejects with one comparison against a cached
+ *   threshold and never touches the heap.
+ * - An item that beats the threshold replaces the root in place with a
+ *   single sift down (Pq::replaceTop).
+ * - Storage is reserved for k items in the constructor and never grows,
+ *   so nothing allocates after construction.
+ *
+ * Ties with the threshold are rejected, so among equal keys the first
+ * ones offered are kept. mergeFrom folds another TopK into this one, which
+ * is how per-thread sets are combined.
+ */
+template<typename T, typename Key = int, typename Compare = std::greater<Key>,
+	std::size_t Arity = 4>
+class TopK {
+	public:
+		// throws std::invalid_argument when k is 0
+		explicit TopK(std::size_t k, const Compare& comp = Compare());
+
+		// true when the item was kept
+		bool offer(const T& item, Key priority);
+		bool offer(T&& item, Key priority);
+		// offers every item of other, other is left empty
+		void mergeFrom(TopK&& other);
+		void mergeFrom(const TopK& other);
+		// key an item has to beat once full, throws std::out_of_range when empty
+		Key threshold() const;
+		// the worst kept item, throws std::out_of_range when empty
+		const T& worst() const;
+		// empties the set, best item first
+		std::vector<std::pair<T, Key> > drainSorted();
+		std::size_t capacity() const;
+		int count() const;
+		bool isEmpty() const;
+		bool isFull() const;
+	private:
+		typedef typename ReverseOrder<Compare>::type Inverse;
+
+		std::size_t k;
+		Compare comp;
+		// worst on top
+		Pq<T, Arity, Key, Inverse> heap;
+		// key of heap's root, only meaningful once full
+		Key bar{};
+		bool full = false;
+
+		// kept out of line so offer() stays small enough to inline into the caller's loop
+		template<typename U>
+		__attribute__((noinline)) bool push(U&& item, Key priority);
+};
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+TopK<T, Key, Compare, Arity>::TopK(std::size_t k, const Compare& comp)
+	: k(k), comp(comp), heap(ReverseOrder<Compare>::make(comp)) {
+	if (k == 0) {
+		throw std::invalid_argument("TopK needs k > 0");
+	}
+	this->heap.reserve(k);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+template<typename U>
+bool TopK<T, Key, Compare, Arity>::push(U&& item, Key priority) {
+	if (this->full) {
+		this->heap.replaceTop(std::forward<U>(item), priority);
+	} else {
+		this->heap.enqueue(std::forward<U>(item), priority);
+		this->full = static_cast<std::size_t>(this->heap.count()) == this->k;
+	}
+	this->bar = this->heap.peekKey();
+	return true;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool TopK<T, Key, Compare, Arity>::offer(const T& item, Key priority) {
+	// the common case for a long stream
+	if (this->full && !this->comp(priority, this->bar)) {
+		return false;
+	}
+	return this->push(item, priority);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool TopK<T, Key, Compare, Arity>::offer(T&& item, Key priority) {
+	if (this->full && !this->comp(priority, this->bar)) {
+		return false;
+	}
+	return this->push(std::move(item), priority);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void TopK<T, Key, Compare, Arity>::mergeFrom(TopK&& other) {
+	if (&other == this) {
+		return;
+	}
+	while (!other.heap.isEmpty()) {
+		Key key = other.heap.peekKey();
+		this->offer(other.heap.dequeue(), key);
+	}
+	other.full = false;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void TopK<T, Key, Compare, Arity>::mergeFrom(const TopK& other) {
+	TopK copy(other);
+	this->mergeFrom(std::move(copy));
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+Key TopK<T, Key, Compare, Arity>::threshold() const {
+	return this->heap.peekKey();
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+const T& TopK<T, Key, Compare, Arity>::worst() const {
+	return this->heap.peek();
+}
+
+// the heap pops worst first, so the result is filled and then reversed
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::vector<std::pair<T, Key> > TopK<T, Key, Compare, Arity>::drainSorted() {
+	std::vector<std::pair<T, Key> > out;
+	out.reserve(this->heap.count());
+	while (!this->heap.isEmpty()) {
+		Key key = this->heap.peekKey();
+		out.emplace_back(this->heap.dequeue(), key);
+	}
+	std::reverse(out.begin(), out.end());
+	this->full = false;
+	return out;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+std::size_t TopK<T, Key, Compare, Arity>::capacity() const {
+	return this->k;
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+int TopK<T, Key, Compare, Arity>::count() const {
+	return this->heap.count();
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool TopK<T, Key, Compare, Arity>::isEmpty() const {
+	return this->heap.isEmpty();
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+bool TopK<T, Key, Compare, Arity>::isFull() const {
+	return this->full;
+}
+
+#endif
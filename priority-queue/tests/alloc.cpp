@@ -0,0 +1,202 @@
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <pq_alloc.hh>
+#include <check.hh>
+
+/*
+ * The memory resources behind PmrPq. Every block handed out is filled
+ * with a pattern and checked later, so overlapping blocks show up as
+ * corrupted patterns and out of bounds writes trip ASan.
+ */
+
+bool aligned(void* p, std::size_t align) {
+	return reinterpret_cast<std::uintptr_t>(p) % align == 0;
+}
+
+struct Block {
+	void* p;
+	std::size_t size;
+	unsigned char fill;
+};
+
+void fill(Block& b) {
+	std::memset(b.p, b.fill, b.size);
+}
+
+bool intact(const Block& b) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(b.p);
+	for (std::size_t i = 0; i < b.size; i++) {
+		if (bytes[i] != b.fill) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void counting() {
+	CountingResource counter;
+	void* a = counter.allocate(100, 8);
+	void* b = counter.allocate(50, 16);
+	AllocStats s = counter.stats();
+	CHECK(s.allocations == 2 && s.deallocations == 0);
+	CHECK(s.bytes == 150 && s.liveBytes == 150 && s.peakBytes == 150);
+
+	counter.deallocate(a, 100, 8);
+	s = counter.stats();
+	CHECK(s.deallocations == 1 && s.liveBytes == 50 && s.peakBytes == 150);
+
+	// live bytes carry over as the new peak
+	counter.resetStats();
+	s = counter.stats();
+	CHECK(s.allocations == 0 && s.bytes == 0 && s.liveBytes == 50 && s.peakBytes == 50);
+	counter.deallocate(b, 50, 16);
+	CHECK(counter.stats().liveBytes == 0);
+}
+
+void arena() {
+	CountingResource upstream;
+	ArenaResource arena(4096, &upstream);
+	CHECK(upstream.stats().allocations == 1);
+
+	std::vector<Block> blocks;
+	const std::size_t aligns[] = {1, 2, 8, 16, 64};
+	for (int i = 0; i < 40; i++) {
+		std::size_t align = aligns[i % 5];
+		Block b{arena.allocate(1 + i * 3, align), std::size_t(1 + i * 3), (unsigned char)i};
+		CHECK(aligned(b.p, align));
+		fill(b);
+		blocks.push_back(b);
+	}
+	CHECK(arena.overflows() == 0);
+	CHECK(upstream.stats().allocations == 1);
+
+	// past the block the overflow comes from upstream
+	Block big{arena.allocate(8000, 16), 8000, 0xaa};
+	fill(big);
+	blocks.push_back(big);
+	CHECK(arena.overflows() == 1);
+	CHECK(upstream.stats().allocations == 2);
+	for (const Block& b : blocks) {
+		CHECK(intact(b));
+	}
+	std::size_t used = arena.used();
+
+	// the reset regrows the block to fit, the same round then stays inside it
+	arena.reset();
+	CHECK(arena.capacity() >= used);
+	CHECK(arena.used() == 0 && arena.overflows() == 0);
+	upstream.resetStats();
+	for (int i = 0; i < 40; i++) {
+		CHECK(arena.allocate(1 + i * 3, aligns[i % 5]) != nullptr);
+	}
+	CHECK(arena.allocate(8000, 16) != nullptr);
+	CHECK(arena.overflows() == 0);
+	CHECK(upstream.stats().allocations == 0);
+}
+
+void callerBuffer() {
+	CountingResource upstream;
+	alignas(64) static unsigned char buffer[1024];
+	ArenaResource arena(buffer, sizeof(buffer), &upstream);
+	void* p = arena.allocate(512, 64);
+	CHECK(p >= (void*)buffer && p < (void*)(buffer + sizeof(buffer)));
+	CHECK(arena.allocate(1024, 8) != nullptr);
+	CHECK(arena.overflows() == 1);
+
+	// a caller owned buffer is never replaced
+	arena.reset();
+	CHECK(arena.capacity() == sizeof(buffer));
+	CHECK(upstream.stats().liveBytes == 0);
+}
+
+void pool() {
+	CountingResource upstream;
+	PoolResource pool(24, 4, &upstream);
+	CHECK(pool.blockSize() % alignof(std::max_align_t) == 0 && pool.blockSize() >= 24);
+
+	std::vector<Block> blocks;
+	for (int i = 0; i < 10; i++) {
+		Block b{pool.allocate(24, 8), 24, (unsigned char)(i + 1)};
+		CHECK(aligned(b.p, alignof(std::max_align_t)));
+		fill(b);
+		blocks.push_back(b);
+	}
+	CHECK(pool.blocksInUse() == 10);
+	CHECK(pool.slabCount() == 3);
+	for (const Block& b : blocks) {
+		CHECK(intact(b));
+	}
+
+	// a freed block is the next one out
+	pool.deallocate(blocks[3].p, 24, 8);
+	CHECK(pool.blocksInUse() == 9);
+	void* again = pool.allocate(16, 8);
+	CHECK(again == blocks[3].p);
+	CHECK(pool.slabCount() == 3);
+
+	// too big or over aligned goes upstream and does not count as a block
+	std::size_t before = upstream.stats().allocations;
+	void* large = pool.allocate(4096, 8);
+	void* wide = pool.allocate(8, 2 * alignof(std::max_align_t));
+	CHECK(upstream.stats().allocations == before + 2);
+	CHECK(pool.blocksInUse() == 10);
+	pool.deallocate(large, 4096, 8);
+	pool.deallocate(wide, 8, 2 * alignof(std::max_align_t));
+	CHECK(upstream.stats().deallocations == 2);
+
+	for (int i = 0; i < 10; i++) {
+		pool.deallocate(blocks[i].p, 24, 8);
+	}
+	CHECK(pool.blocksInUse() == 0);
+}
+
+// a queue of strings that all live in the arena, drained in order round after round
+void pqInArena() {
+	CountingResource upstream;
+	ArenaResource arena(1 << 16, &upstream);
+	for (int round = 0; round < 3; round++) {
+		if (round == 2) {
+			upstream.resetStats();
+		}
+		{
+			PmrPq<std::pmr::string, 4, int, std::less<int> > q(&arena);
+			for (int i = 0; i < 500; i++) {
+				int key = (i * 37) % 500;
+				q.emplace(key, std::string(40, 'a' + key % 26));
+			}
+			for (int expect = 0; expect < 500; expect++) {
+				CHECK(q.peekKey() == expect);
+				std::pmr::string s = q.dequeue();
+				CHECK(s.size() == 40 && s[0] == 'a' + expect % 26);
+			}
+		}
+		arena.reset();
+	}
+	// after a round to size the block, nothing goes upstream
+	CHECK(upstream.stats().allocations == 0);
+}
+
+void pqInPool() {
+	PoolResource pool(256, 16);
+	PmrPq<int> q(&pool);
+	for (int i = 0; i < 1000; i++) {
+		q.enqueue(i, (i * 7919) % 1000);
+	}
+	for (int expect = 999; expect >= 0; expect--) {
+		CHECK(q.peekKey() == expect);
+		q.dequeue();
+	}
+}
+
+int main() {
+	counting();
+	arena();
+	callerBuffer();
+	pool();
+	pqInArena();
+	pqInPool();
+	return checkResult("alloc");
+}
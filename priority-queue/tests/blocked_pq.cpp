@@ -0,0 +1,113 @@
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+#include <pq.hh>
+#include <check.hh>
+
+/*
+ * BlockedPq against the breadth first Pq it is meant to replace. Both get
+ * the same enqueues, bulk loads, replaceTops and pops, with sizes well
+ * past a block of small Levels so the sifts cross block boundaries.
+ * Keys have to come out in the same order. Which of two equal keys comes
+ * first may differ, so payloads are only checked against their key.
+ */
+
+// the blocked slot map has to invert: every child of i has i as its parent
+template<std::size_t Arity, std::size_t Levels>
+void shape(std::size_t slots) {
+	typedef BlockedLayout<Levels> L;
+	bool ok = true;
+	for (std::size_t i = 0; i < slots; i++) {
+		std::size_t first = L::template child<Arity>(i);
+		std::size_t width = i == 0 ? 1 : Arity;
+		for (std::size_t c = first; c < first + width && c < slots; c++) {
+			ok = ok && c > i && L::template parent<Arity>(c) == i;
+		}
+	}
+	CHECK(ok);
+}
+
+template<std::size_t Arity, std::size_t Levels, typename Compare>
+void against(std::size_t n, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> keys(-static_cast<int>(n) / 2, static_cast<int>(n) / 2);
+	Pq<int, Arity, int, Compare> implicit;
+	BlockedPq<int, Arity, int, Compare, Levels> blocked;
+	// payload p was enqueued with key of[p]
+	std::vector<int> of;
+
+	auto push = [&]() {
+		int key = keys(rng);
+		int id = static_cast<int>(of.size());
+		of.push_back(key);
+		implicit.enqueue(id, key);
+		blocked.enqueue(id, key);
+	};
+	bool same = true;
+	auto pop = [&]() {
+		int expect = implicit.peekKey();
+		same = same && blocked.peekKey() == expect;
+		implicit.dequeue();
+		same = same && of[blocked.dequeue()] == expect;
+	};
+
+	std::vector<std::pair<int, int> > bulk;
+	for (std::size_t i = 0; i < n / 2; i++) {
+		int key = keys(rng);
+		bulk.emplace_back(static_cast<int>(of.size()), key);
+		of.push_back(key);
+	}
+	implicit.enqueueBulk(bulk);
+	blocked.enqueueBulk(bulk);
+
+	for (std::size_t i = 0; i < 2 * n; i++) {
+		switch (rng() % 4) {
+			case 0:
+			case 1:
+				push();
+				break;
+			case 2:
+				if (!implicit.isEmpty()) {
+					pop();
+				}
+				break;
+			default:
+				if (!implicit.isEmpty()) {
+					int key = keys(rng);
+					int id = static_cast<int>(of.size());
+					of.push_back(key);
+					implicit.replaceTop(id, key);
+					blocked.replaceTop(id, key);
+				}
+		}
+	}
+	CHECK(blocked.count() == implicit.count());
+	while (!implicit.isEmpty()) {
+		pop();
+	}
+	CHECK(same);
+	CHECK(blocked.isEmpty());
+	CHECK_THROWS(blocked.dequeue(), std::out_of_range);
+}
+
+template<std::size_t Arity, std::size_t Levels>
+void layout() {
+	shape<Arity, Levels>(20000);
+	for (std::size_t n : {1, 2, 5, 100, 5000, 40000}) {
+		against<Arity, Levels, std::greater<int> >(n, static_cast<unsigned>(n + Arity));
+		against<Arity, Levels, std::less<int> >(n, static_cast<unsigned>(n * Levels));
+	}
+}
+
+int main() {
+	layout<2, 1>();
+	layout<2, 3>();
+	layout<2, 9>();
+	layout<4, 2>();
+	layout<4, 4>();
+	layout<8, 2>();
+	layout<3, 3>();
+	return checkResult("blocked_pq");
+}
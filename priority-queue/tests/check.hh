@@ -0,0 +1,54 @@
+#ifndef TEST_CHECK_H
+
+#define TEST_CHECK_H
+
+#include <cstdio>
+#include <stdexcept>
+
+/*
+ * Minimal checks for the tests. A failed CHECK prints where it failed
+ * and carries on, so one run shows every broken expectation.
+ * checkResult() turns the failure count into the exit status that
+ * make test looks at.
+ */
+
+inline int& checkFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			checkFailures()++; \
+		} \
+	} while (0)
+
+// expr has to throw exactly Exception, or something derived from it
+#define CHECK_THROWS(expr, Exception) \
+	do { \
+		bool thrown = false; \
+		try { \
+			(void)(expr); \
+		} catch (const Exception&) { \
+			thrown = true; \
+		} catch (...) { \
+		} \
+		if (!thrown) { \
+			std::fprintf(stderr, "%s:%d: CHECK failed: %s throws %s\n", __FILE__, __LINE__, \
+				#expr, #Exception); \
+			checkFailures()++; \
+		} \
+	} while (0)
+
+inline int checkResult(const char* name) {
+	if (checkFailures() > 0) {
+		std::fprintf(stderr, "%s: %d checks failed\n", name, checkFailures());
+		return 1;
+	}
+	std::printf("%s: ok\n", name);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,267 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <executor.hh>
+#include <check.hh>
+
+/*
+ * Executor behaviour that the benches do not look at: run order within
+ * and across classes, deadlines expiring in the queue, stealing from a
+ * busy worker, failures, and shutdown running everything still queued.
+ * Workers are held on a Gate so the queues fill before anything runs.
+ */
+
+typedef Executor::Clock Clock;
+
+// a task that blocks its worker until open() and says when it has started
+class Gate {
+	public:
+		Gate() : released(opened.get_future().share()) {}
+
+		void submitTo(Executor& ex, std::size_t priorityClass) {
+			std::shared_future<void> wait = this->released;
+			std::promise<void>* running = &this->started;
+			ex.submit(priorityClass, [wait, running]() {
+				running->set_value();
+				wait.wait();
+			});
+		}
+
+		void waitStarted() {
+			this->started.get_future().wait();
+		}
+
+		void open() {
+			this->opened.set_value();
+		}
+	private:
+		std::promise<void> opened;
+		std::shared_future<void> released;
+		std::promise<void> started;
+};
+
+// tags of tasks in the order they ran
+class RunLog {
+	public:
+		std::function<void()> task(int tag) {
+			return [this, tag]() {
+				std::lock_guard<std::mutex> guard(this->lock);
+				this->tags.push_back(tag);
+			};
+		}
+
+		std::vector<int> order() {
+			std::lock_guard<std::mutex> guard(this->lock);
+			return this->tags;
+		}
+	private:
+		std::mutex lock;
+		std::vector<int> tags;
+};
+
+// one worker: class first, then earliest deadline, then submission order
+void order() {
+	Executor ex(1, 4);
+	Gate gate;
+	gate.submitTo(ex, 3);
+	gate.waitStarted();
+
+	RunLog log;
+	Clock::time_point later = Clock::now() + std::chrono::hours(1);
+	ex.submit(0, log.task(0));
+	ex.submit(2, log.task(21));
+	ex.submit(2, later + std::chrono::seconds(2), log.task(12));
+	ex.submit(0, log.task(1));
+	ex.submit(2, later, log.task(11));
+	ex.submit(3, log.task(30));
+	ex.submit(2, log.task(22));
+	gate.open();
+	ex.waitIdle();
+	CHECK(log.order() == std::vector<int>({30, 11, 12, 21, 22, 0, 1}));
+}
+
+// tasks past their deadline when taken are dropped and counted, the rest run
+void deadlines() {
+	Executor ex(1, 2);
+	Gate gate;
+	gate.submitTo(ex, 1);
+	gate.waitStarted();
+
+	std::atomic<int> ran{0};
+	auto count = [&ran]() {
+		ran++;
+	};
+	Clock::time_point now = Clock::now();
+	for (int i = 0; i < 5; i++) {
+		ex.submit(0, now - std::chrono::milliseconds(1), count);
+		ex.submit(1, now + std::chrono::milliseconds(20), count);
+		ex.submit(1, now + std::chrono::hours(1), count);
+		ex.submit(0, count);
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	gate.open();
+	ex.waitIdle();
+
+	std::vector<ExecutorClassStats> stats = ex.stats();
+	CHECK(ran == 10);
+	CHECK(stats[0].expired == 5 && stats[0].completed == 5);
+	CHECK(stats[1].expired == 5 && stats[1].completed == 6);
+}
+
+// work submitted from a worker lands in its own queue, others have to steal it
+void stealing() {
+	const int tasks = 64;
+	Executor ex(4, 1);
+	std::atomic<int> done{0};
+	std::atomic<int> onSubmitter{0};
+	std::atomic<bool> finished{false};
+
+	ex.submit(0, [&]() {
+		std::thread::id self = std::this_thread::get_id();
+		for (int i = 0; i < tasks; i++) {
+			ex.submit(0, [&, self]() {
+				onSubmitter += std::this_thread::get_id() == self;
+				done++;
+			});
+		}
+		// this worker stays busy, so only stealing can finish the batch
+		Clock::time_point limit = Clock::now() + std::chrono::seconds(10);
+		while (done.load() < tasks && Clock::now() < limit) {
+			std::this_thread::yield();
+		}
+		finished = done.load() == tasks;
+	});
+	ex.waitIdle();
+	CHECK(finished);
+	CHECK(onSubmitter == 0);
+}
+
+// a freed worker drains the other worker's queue in class order too
+void acrossPool() {
+	Executor ex(2, 2);
+	Gate first;
+	Gate second;
+	first.submitTo(ex, 1);
+	second.submitTo(ex, 1);
+	first.waitStarted();
+	second.waitStarted();
+
+	RunLog log;
+	for (int i = 0; i < 50; i++) {
+		ex.submit(i % 2, log.task(i % 2));
+	}
+	first.open();
+	Clock::time_point limit = Clock::now() + std::chrono::seconds(10);
+	while (log.order().size() < 50 && Clock::now() < limit) {
+		std::this_thread::yield();
+	}
+	second.open();
+	ex.waitIdle();
+
+	std::vector<int> ran = log.order();
+	std::vector<int> expect(25, 1);
+	expect.resize(50, 0);
+	CHECK(ran == expect);
+}
+
+void failures() {
+	Executor ex(2, 1);
+	std::atomic<int> ran{0};
+	for (int i = 0; i < 20; i++) {
+		ex.submit(0, [&ran, i]() {
+			ran++;
+			if (i % 2) {
+				throw std::runtime_error("task failed");
+			}
+		});
+	}
+	ex.waitIdle();
+	std::vector<ExecutorClassStats> stats = ex.stats();
+	CHECK(ran == 20);
+	CHECK(stats[0].failed == 10 && stats[0].completed == 10);
+	CHECK_THROWS(ex.submit(1, []() {}), std::invalid_argument);
+}
+
+// shutdown and the destructor run everything queued before they return
+void drain() {
+	std::atomic<int> ran{0};
+	auto count = [&ran]() {
+		ran++;
+	};
+	{
+		Executor ex(2, 2);
+		Gate first;
+		Gate second;
+		first.submitTo(ex, 1);
+		second.submitTo(ex, 1);
+		first.waitStarted();
+		second.waitStarted();
+		for (int i = 0; i < 1000; i++) {
+			ex.submit(i % 2, count);
+		}
+		std::thread stopper([&ex]() {
+			ex.shutdown();
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		first.open();
+		second.open();
+		stopper.join();
+		CHECK(ran == 1000);
+		CHECK_THROWS(ex.submit(0, count), std::runtime_error);
+	}
+
+	ran = 0;
+	{
+		Executor ex(3, 1);
+		for (int i = 0; i < 500; i++) {
+			ex.submit(0, count);
+		}
+	}
+	CHECK(ran == 500);
+}
+
+// tasks submitted while shutdown() runs either throw or run, never neither
+void racingShutdown() {
+	bool same = true;
+	for (int round = 0; round < 200; round++) {
+		std::atomic<int> ran{0};
+		std::atomic<int> accepted{0};
+		Executor ex(2, 2);
+		std::vector<std::thread> submitters;
+		for (int t = 0; t < 3; t++) {
+			submitters.emplace_back([&ex, &ran, &accepted, t]() {
+				try {
+					while (true) {
+						ex.submit(t % 2, [&ran]() {
+							ran++;
+						});
+						accepted++;
+					}
+				} catch (const std::runtime_error&) {
+				}
+			});
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(100 * (round % 10)));
+		ex.shutdown();
+		for (std::thread& t : submitters) {
+			t.join();
+		}
+		same = same && ran == accepted;
+	}
+	CHECK(same);
+}
+
+int main() {
+	order();
+	deadlines();
+	stealing();
+	acrossPool();
+	failures();
+	drain();
+	racingShutdown();
+	return checkResult("executor");
+}
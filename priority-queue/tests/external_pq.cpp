@@ -0,0 +1,147 @@
+#include <csignal>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+#include <external_pq.hh>
+#include <check.hh>
+
+/*
+ * ExternalPq against std::priority_queue, with a budget small enough that
+ * the insertion buffer spills many times and the runs get compacted. The
+ * records are 12 bytes, so they straddle the page aligned mmap windows.
+ * Ties can come out in either order, so keys are compared one by one and
+ * payloads as a sum.
+ */
+
+struct Payload {
+	std::int32_t id;
+	std::int32_t check;
+};
+
+const std::size_t BUDGET = 512 << 10;
+
+template<typename Compare, typename StdCompare>
+void againstStd(int items, bool interleave) {
+	ExternalPq<Payload, int, Compare> q(BUDGET);
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int> >, StdCompare> ref;
+	std::mt19937 rng(items);
+	std::uniform_int_distribution<int> keys(-1000000, 1000000);
+	long long pushedIds = 0;
+	long long poppedIds = 0;
+	bool keysMatch = true;
+	bool payloadsIntact = true;
+	std::size_t maxRuns = 0;
+
+	auto popOne = [&]() {
+		int key = q.peekKey();
+		keysMatch = keysMatch && key == ref.top().first;
+		Payload p = q.dequeue();
+		payloadsIntact = payloadsIntact && p.check == p.id * 31 + 7;
+		poppedIds += p.id;
+		ref.pop();
+	};
+
+	for (int i = 0; i < items; i++) {
+		int key = keys(rng);
+		q.enqueue(Payload{i, i * 31 + 7}, key);
+		ref.push(std::make_pair(key, i));
+		pushedIds += i;
+		maxRuns = std::max(maxRuns, q.runCount());
+		if (interleave && i % 3 == 0) {
+			popOne();
+		}
+	}
+	CHECK(q.count() == ref.size());
+	CHECK(q.bytesSpilled() > 0);
+	CHECK(maxRuns >= 2);
+	while (!ref.empty()) {
+		popOne();
+	}
+	CHECK(keysMatch);
+	CHECK(payloadsIntact);
+	CHECK(pushedIds == poppedIds);
+	CHECK(q.isEmpty() && q.runCount() == 0);
+	CHECK(!q.tryDequeue().has_value());
+	CHECK_THROWS(q.dequeue(), std::out_of_range);
+	CHECK_THROWS(q.peek(), std::out_of_range);
+}
+
+// with nothing spilled it is just the buffer
+void inMemory() {
+	ExternalPq<Payload> q(BUDGET);
+	for (int i = 0; i < 100; i++) {
+		q.enqueue(Payload{i, 0}, i);
+	}
+	CHECK(q.runCount() == 0 && q.bytesSpilled() == 0);
+	CHECK(q.peek().id == 99);
+	for (int i = 99; i >= 0; i--) {
+		std::optional<Payload> p = q.tryDequeue();
+		CHECK(p.has_value() && p->id == i);
+	}
+}
+
+void tooSmall() {
+	CHECK_THROWS(ExternalPq<Payload>(1024), std::invalid_argument);
+}
+
+/*
+ * A spill that fails partway keeps every item. RLIMIT_FSIZE stops the
+ * spill file after its first flushed block, so some records are on disk
+ * and the rest are still in the write buffer when the write fails.
+ */
+void failedSpill() {
+	ExternalPq<Payload> q(BUDGET);
+	std::priority_queue<std::pair<int, int> > ref;
+	std::mt19937 rng(17);
+
+	struct rlimit old;
+	getrlimit(RLIMIT_FSIZE, &old);
+	struct rlimit small = old;
+	small.rlim_cur = 100 << 10;
+	std::signal(SIGXFSZ, SIG_IGN);
+	setrlimit(RLIMIT_FSIZE, &small);
+
+	bool failed = false;
+	for (int i = 0; !failed && i < 100000; i++) {
+		int key = static_cast<int>(rng() % 1000000);
+		try {
+			q.enqueue(Payload{i, i * 31 + 7}, key);
+			ref.push(std::make_pair(key, i));
+		} catch (const std::system_error&) {
+			failed = true;
+		}
+	}
+	setrlimit(RLIMIT_FSIZE, &old);
+	std::signal(SIGXFSZ, SIG_DFL);
+
+	CHECK(failed);
+	CHECK(q.runCount() == 0 && q.count() == ref.size());
+	// with the limit gone the same queue spills and drains normally
+	for (int i = 0; i < 50000; i++) {
+		int key = static_cast<int>(rng() % 1000000);
+		q.enqueue(Payload{-i, -i * 31 + 7}, key);
+		ref.push(std::make_pair(key, -i));
+	}
+	CHECK(q.runCount() > 0);
+	bool same = q.count() == ref.size();
+	while (same && !ref.empty()) {
+		same = q.peekKey() == ref.top().first;
+		Payload p = q.dequeue();
+		same = same && p.check == p.id * 31 + 7;
+		ref.pop();
+	}
+	CHECK(same && q.isEmpty());
+}
+
+int main() {
+	inMemory();
+	tooSmall();
+	failedSpill();
+	// a 512 KiB budget buffers about 21k records, so these spill and compact
+	againstStd<std::greater<int>, std::less<std::pair<int, int> > >(300000, false);
+	againstStd<std::less<int>, std::greater<std::pair<int, int> > >(300000, true);
+	return checkResult("external_pq");
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <loser_tree.hh>
+#include <pq_sort.hh>
+#include <check.hh>
+
+/*
+ * LoserTree against std::sort of all runs concatenated. Run counts
+ * cover K=0, 1 and non powers of two, and about a quarter of the runs
+ * are empty. Integer values take the branch free replay, doubles the
+ * plain one.
+ */
+
+template<typename T, typename Compare>
+std::vector<std::vector<T> > makeRuns(std::size_t k, std::mt19937& rng) {
+	std::uniform_int_distribution<int> len(0, 200);
+	std::uniform_int_distribution<int> value(-1000, 1000);
+	std::vector<std::vector<T> > runs(k);
+	for (std::vector<T>& run : runs) {
+		if (rng() % 4 == 0) {
+			continue;
+		}
+		run.resize(len(rng));
+		for (T& v : run) {
+			v = static_cast<T>(value(rng));
+		}
+		std::sort(run.begin(), run.end(), Compare());
+	}
+	return runs;
+}
+
+template<typename T, typename Compare>
+void merge(std::size_t k, std::mt19937& rng) {
+	typedef typename std::vector<T>::const_iterator It;
+	std::vector<std::vector<T> > runs = makeRuns<T, Compare>(k, rng);
+	std::vector<std::pair<It, It> > ranges;
+	std::vector<T> expect;
+	for (const std::vector<T>& run : runs) {
+		ranges.emplace_back(run.begin(), run.end());
+		expect.insert(expect.end(), run.begin(), run.end());
+	}
+	std::sort(expect.begin(), expect.end(), Compare());
+
+	// one at a time, every element has to come from the run peekSource names
+	LoserTree<It, Compare> tree(ranges);
+	CHECK(tree.sourceCount() == k);
+	std::vector<std::size_t> taken(k, 0);
+	std::vector<T> got;
+	while (!tree.isEmpty()) {
+		std::size_t src = tree.peekSource();
+		CHECK(src < k && taken[src] < runs[src].size() && runs[src][taken[src]] == tree.peek());
+		taken[src]++;
+		got.push_back(tree.dequeue());
+	}
+	CHECK(got == expect);
+	CHECK_THROWS(tree.peek(), std::out_of_range);
+	CHECK_THROWS(tree.dequeue(), std::out_of_range);
+
+	// in batches, the last one short
+	LoserTree<It, Compare> batched(ranges);
+	got.clear();
+	while (batched.dequeueBatch(7, std::back_inserter(got)) == 7) {
+	}
+	CHECK(got == expect);
+
+	got.clear();
+	mergeSorted(ranges, std::back_inserter(got), Compare());
+	CHECK(got == expect);
+}
+
+// single pass input iterators
+void streams() {
+	std::istringstream a("1 4 9 12");
+	std::istringstream b("");
+	std::istringstream c("2 3 10");
+	typedef std::istream_iterator<int> It;
+	std::vector<std::pair<It, It> > ranges = {
+		{It(a), It()}, {It(b), It()}, {It(c), It()}
+	};
+	std::vector<int> got;
+	mergeSorted(ranges, std::back_inserter(got));
+	CHECK(got == std::vector<int>({1, 2, 3, 4, 9, 10, 12}));
+}
+
+// a string that counts how often it is copied
+struct Tracked {
+	static int copies;
+	std::string s;
+
+	Tracked() = default;
+	explicit Tracked(std::string s) : s(std::move(s)) {}
+	Tracked(const Tracked& other) : s(other.s) {
+		copies++;
+	}
+	Tracked(Tracked&&) = default;
+	Tracked& operator=(const Tracked& other) {
+		copies++;
+		this->s = other.s;
+		return *this;
+	}
+	Tracked& operator=(Tracked&&) = default;
+
+	bool operator<(const Tracked& other) const {
+		return this->s < other.s;
+	}
+
+	bool operator>(const Tracked& other) const {
+		return this->s > other.s;
+	}
+};
+
+int Tracked::copies = 0;
+
+std::vector<Tracked> trackedStrings(std::size_t n, std::mt19937& rng) {
+	std::vector<Tracked> out;
+	out.reserve(n);
+	for (std::size_t i = 0; i < n; i++) {
+		// long enough to live on the heap, not in the small string buffer
+		out.emplace_back(std::to_string(rng()) + std::string(24, 'x'));
+	}
+	return out;
+}
+
+// over move iterators the merge and pqSort copy nothing
+void noCopies() {
+	std::mt19937 rng(13);
+	std::vector<std::vector<Tracked> > runs;
+	std::vector<std::string> expect;
+	for (int r = 0; r < 9; r++) {
+		runs.push_back(trackedStrings(r * 50, rng));
+		std::sort(runs.back().begin(), runs.back().end());
+		for (const Tracked& t : runs.back()) {
+			expect.push_back(t.s);
+		}
+	}
+	std::sort(expect.begin(), expect.end());
+
+	typedef std::move_iterator<std::vector<Tracked>::iterator> It;
+	std::vector<std::pair<It, It> > ranges;
+	for (std::vector<Tracked>& run : runs) {
+		ranges.emplace_back(std::make_move_iterator(run.begin()), std::make_move_iterator(run.end()));
+	}
+	std::vector<Tracked> merged;
+	merged.reserve(expect.size());
+	Tracked::copies = 0;
+	LoserTree<It> tree(ranges);
+	for (int i = 0; i < 3 && !tree.isEmpty(); i++) {
+		merged.push_back(tree.dequeue());
+	}
+	tree.dequeueBatch(100, std::back_inserter(merged));
+	tree.drainInto(std::back_inserter(merged));
+	CHECK(Tracked::copies == 0);
+	bool same = merged.size() == expect.size();
+	for (std::size_t i = 0; same && i < merged.size(); i++) {
+		same = merged[i].s == expect[i];
+	}
+	CHECK(same);
+
+	// enough for several runs, so pqSort goes through the LoserTree merge
+	std::vector<Tracked> big = trackedStrings(3 * SORT_RUN + 5, rng);
+	expect.clear();
+	for (const Tracked& t : big) {
+		expect.push_back(t.s);
+	}
+	std::sort(expect.begin(), expect.end());
+	Tracked::copies = 0;
+	pqSort(big.begin(), big.end(), 2);
+	CHECK(Tracked::copies == 0);
+	same = true;
+	for (std::size_t i = 0; i < big.size(); i++) {
+		same = same && big[i].s == expect[i];
+	}
+	CHECK(same);
+}
+
+int main() {
+	std::mt19937 rng(7);
+	for (std::size_t k : {0, 1, 2, 3, 5, 8, 17, 64, 100}) {
+		for (int round = 0; round < 4; round++) {
+			merge<int, std::less<int> >(k, rng);
+			merge<std::int64_t, std::greater<std::int64_t> >(k, rng);
+			merge<std::uint16_t, std::less<std::uint16_t> >(k, rng);
+			merge<double, std::greater<double> >(k, rng);
+		}
+	}
+	streams();
+	noCopies();
+	return checkResult("loser_tree");
+}
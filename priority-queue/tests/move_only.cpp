@@ -0,0 +1,147 @@
+#include <memory>
+#include <optional>
+#include <vector>
+#include <pq.hh>
+#include <check.hh>
+
+/*
+ * Pq moves payloads, it only copies when handed a const T&. Counted
+ * counts every copy and move made of it. unique_ptr cannot be copied at
+ * all, so it only compiles and round-trips if nothing tries.
+ */
+
+struct Counted {
+	static int copies;
+	static int moves;
+
+	int value;
+
+	explicit Counted(int value = 0) : value(value) {}
+	Counted(const Counted& other) : value(other.value) {
+		copies++;
+	}
+	Counted(Counted&& other) noexcept : value(other.value) {
+		moves++;
+	}
+	Counted& operator=(const Counted& other) {
+		this->value = other.value;
+		copies++;
+		return *this;
+	}
+	Counted& operator=(Counted&& other) noexcept {
+		this->value = other.value;
+		moves++;
+		return *this;
+	}
+
+	static void reset() {
+		copies = 0;
+		moves = 0;
+	}
+};
+
+int Counted::copies = 0;
+int Counted::moves = 0;
+
+const int N = 1000;
+
+// priorities in a scrambled order, so the items really travel through the heap
+int scrambled(int i) {
+	return (i * 7919) % N;
+}
+
+template<typename Queue>
+void drainInOrder(Queue& q) {
+	for (int expect = N - 1; expect >= 0; expect--) {
+		Counted c = q.dequeue();
+		CHECK(c.value == expect);
+	}
+	CHECK(q.isEmpty());
+}
+
+template<std::size_t Arity>
+void rvalueEnqueue() {
+	Pq<Counted, Arity> q;
+	Counted::reset();
+	for (int i = 0; i < N; i++) {
+		q.enqueue(Counted(scrambled(i)), scrambled(i));
+	}
+	drainInOrder(q);
+	CHECK(Counted::copies == 0);
+	CHECK(Counted::moves > 0);
+}
+
+template<std::size_t Arity>
+void emplace() {
+	Pq<Counted, Arity> q;
+	Counted::reset();
+	for (int i = 0; i < N; i++) {
+		q.emplace(scrambled(i), scrambled(i));
+	}
+	drainInOrder(q);
+	CHECK(Counted::copies == 0);
+}
+
+template<std::size_t Arity>
+void constRefEnqueue() {
+	Pq<Counted, Arity> q;
+	std::vector<Counted> items;
+	for (int i = 0; i < N; i++) {
+		items.emplace_back(scrambled(i));
+	}
+	Counted::reset();
+	for (const Counted& c : items) {
+		q.enqueue(c, c.value);
+	}
+	// exactly one copy into the queue per item, none on the way out
+	CHECK(Counted::copies == N);
+	drainInOrder(q);
+	CHECK(Counted::copies == N);
+}
+
+void tryDequeue() {
+	Pq<Counted> q;
+	for (int i = 0; i < N; i++) {
+		q.emplace(scrambled(i), scrambled(i));
+	}
+	Counted::reset();
+	for (int expect = N - 1; expect >= 0; expect--) {
+		std::optional<Counted> c = q.tryDequeue();
+		CHECK(c.has_value() && c->value == expect);
+	}
+	CHECK(!q.tryDequeue().has_value());
+	CHECK(Counted::copies == 0);
+}
+
+void uniquePtr() {
+	Pq<std::unique_ptr<int>, 4> q;
+	for (int i = 0; i < N; i++) {
+		if (i % 2 == 0) {
+			q.enqueue(std::make_unique<int>(scrambled(i)), scrambled(i));
+		} else {
+			q.emplace(scrambled(i), new int(scrambled(i)));
+		}
+	}
+	CHECK(*q.peek() == N - 1);
+	q.replaceTop(std::make_unique<int>(-1), -1);
+	for (int expect = N - 2; expect >= 0; expect--) {
+		std::unique_ptr<int> p = q.dequeue();
+		CHECK(p != nullptr && *p == expect);
+	}
+	std::optional<std::unique_ptr<int> > last = q.tryDequeue();
+	CHECK(last.has_value() && **last == -1);
+	CHECK(!q.tryDequeue().has_value());
+	CHECK_THROWS(q.dequeue(), std::out_of_range);
+}
+
+int main() {
+	rvalueEnqueue<2>();
+	rvalueEnqueue<4>();
+	emplace<2>();
+	emplace<8>();
+	constRefEnqueue<2>();
+	constRefEnqueue<4>();
+	tryDequeue();
+	uniquePtr();
+	return checkResult("move_only");
+}
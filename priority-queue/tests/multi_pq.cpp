@@ -0,0 +1,111 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <multi_pq.hh>
+#include <check.hh>
+
+/*
+ * A Pq operation that throws must not leave its shard locked. With one
+ * shard every later push and pop needs that same lock, so a leaked lock
+ * shows up as this test hanging.
+ */
+
+struct Fragile {
+	static bool failCopy;
+	static bool failMove;
+
+	int value;
+
+	explicit Fragile(int value = 0) : value(value) {}
+	Fragile(const Fragile& other) : value(other.value) {
+		if (failCopy) {
+			throw std::runtime_error("copy");
+		}
+	}
+	Fragile(Fragile&& other) : value(other.value) {
+		if (failMove) {
+			throw std::runtime_error("move");
+		}
+	}
+	Fragile& operator=(const Fragile& other) = default;
+	Fragile& operator=(Fragile&& other) = default;
+};
+
+bool Fragile::failCopy = false;
+bool Fragile::failMove = false;
+
+void throwingCopy() {
+	MultiPq<Fragile> q(1);
+	Fragile item(7);
+	Fragile::failCopy = true;
+	CHECK_THROWS(q.enqueue(item, 7), std::runtime_error);
+	Fragile::failCopy = false;
+	CHECK(q.isEmpty());
+
+	q.enqueue(item, 7);
+	std::optional<Fragile> got = q.tryDequeue();
+	CHECK(got.has_value() && got->value == 7);
+	CHECK(!q.tryDequeue().has_value());
+}
+
+void throwingMove() {
+	MultiPq<Fragile> q(1);
+	q.enqueue(Fragile(1), 1);
+	Fragile::failMove = true;
+	CHECK_THROWS(q.tryDequeue(), std::runtime_error);
+	Fragile::failMove = false;
+
+	// the shard is usable again
+	q.enqueue(Fragile(2), 2);
+	std::optional<Fragile> got = q.tryDequeue();
+	CHECK(got.has_value());
+}
+
+void concurrentRoundTrip() {
+	const int threads = 4;
+	const int perThread = 20000;
+	MultiPq<int> q(2 * threads);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&q, t]() {
+			for (int i = 0; i < perThread; i++) {
+				int v = t * perThread + i;
+				q.enqueue(v, v);
+			}
+		});
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+	CHECK(q.count() == threads * perThread);
+
+	std::vector<std::atomic<int> > seen(threads * perThread);
+	std::atomic<int> popped{0};
+	workers.clear();
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&]() {
+			while (std::optional<int> v = q.tryDequeue()) {
+				seen[*v].fetch_add(1);
+				popped.fetch_add(1);
+			}
+		});
+	}
+	for (std::thread& w : workers) {
+		w.join();
+	}
+	CHECK(popped.load() == threads * perThread);
+	bool once = true;
+	for (std::atomic<int>& s : seen) {
+		once = once && s.load() == 1;
+	}
+	CHECK(once);
+	CHECK(q.isEmpty());
+}
+
+int main() {
+	throwingCopy();
+	throwingMove();
+	concurrentRoundTrip();
+	return checkResult("multi_pq");
+}
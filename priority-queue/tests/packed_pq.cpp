@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
+#include <packed_pq.hh>
+#include <pq.hh>
+#include <check.hh>
+
+/*
+ * KeyPq and PackedPq over signed keys against a sorted reference. Keys
+ * span the whole range of the type, including its minimum and maximum,
+ * so a missing or doubled sign flip in PackedPq shows up as negative keys
+ * coming out on the wrong side. Both the 4 byte and the 8 byte word are
+ * covered. Payloads are indices into the key list.
+ */
+
+template<typename Key>
+std::vector<Key> signedKeys(std::size_t n, std::mt19937& rng) {
+	std::uniform_int_distribution<long long> any(std::numeric_limits<Key>::min(),
+		std::numeric_limits<Key>::max());
+	std::vector<Key> keys = {std::numeric_limits<Key>::min(), std::numeric_limits<Key>::max(),
+		Key(-1), Key(0), Key(1), Key(-1)};
+	while (keys.size() < n) {
+		keys.push_back(static_cast<Key>(any(rng)));
+	}
+	std::shuffle(keys.begin(), keys.end(), rng);
+	return keys;
+}
+
+template<typename Key, typename Compare, std::size_t Arity>
+void keyOnly(std::mt19937& rng) {
+	std::vector<Key> keys = signedKeys<Key>(5000, rng);
+	std::vector<Key> expect = keys;
+	std::sort(expect.begin(), expect.end(), Compare());
+
+	KeyPq<Key, Arity, Compare> q;
+	for (Key k : keys) {
+		q.enqueue(k);
+	}
+	std::vector<Key> got;
+	while (!q.isEmpty()) {
+		got.push_back(q.dequeue());
+	}
+	CHECK(got == expect);
+
+	KeyPq<Key, Arity, Compare> bulk(keys.begin(), keys.end());
+	got.clear();
+	bulk.dequeueBatch(keys.size(), std::back_inserter(got));
+	CHECK(got == expect);
+}
+
+template<typename T, typename Key, typename Compare, std::size_t Arity>
+void packed(std::mt19937& rng) {
+	typedef PackedPq<T, Key, Compare, Arity> Q;
+	std::size_t n = std::min<std::size_t>(5000, std::numeric_limits<T>::max());
+	std::vector<Key> keys = signedKeys<Key>(n, rng);
+	std::vector<Key> expect = keys;
+	std::sort(expect.begin(), expect.end(), Compare());
+
+	Q q;
+	q.reserve(n);
+	for (std::size_t i = 0; i < n; i++) {
+		q.enqueue(static_cast<T>(i), keys[i]);
+	}
+	CHECK(q.count() == static_cast<int>(n));
+
+	// every payload has to come out with the key it went in with
+	bool same = true;
+	for (std::size_t i = 0; i < n; i++) {
+		Key k = q.peekKey();
+		T item = q.peek();
+		same = same && k == expect[i] && q.dequeue() == item && keys[item] == k;
+	}
+	CHECK(same);
+	CHECK(!q.tryDequeue());
+	CHECK_THROWS(q.dequeue(), std::out_of_range);
+	CHECK_THROWS(q.peekKey(), std::out_of_range);
+	CHECK_THROWS(q.replaceTop(T(0), Key(0)), std::out_of_range);
+
+	// replaceTop with keys on both sides of zero
+	Q top;
+	top.enqueue(T(1), Key(-5));
+	top.enqueue(T(2), Key(5));
+	top.replaceTop(T(3), Key(0));
+	std::vector<T> order;
+	top.dequeueBatch(2, std::back_inserter(order));
+	bool max = std::is_same<Compare, std::greater<Key> >::value;
+	CHECK(order == (max ? std::vector<T>({3, 1}) : std::vector<T>({3, 2})));
+}
+
+int main() {
+	std::mt19937 rng(3);
+	keyOnly<std::int8_t, std::greater<std::int8_t>, 2>(rng);
+	keyOnly<std::int16_t, std::less<std::int16_t>, 4>(rng);
+	keyOnly<int, std::greater<int>, 4>(rng);
+	keyOnly<int, std::less<int>, 8>(rng);
+	keyOnly<std::int64_t, std::greater<std::int64_t>, 4>(rng);
+	keyOnly<std::int64_t, std::less<std::int64_t>, 2>(rng);
+
+	// 4 byte words
+	packed<std::uint16_t, std::int16_t, std::greater<std::int16_t>, 4>(rng);
+	packed<std::uint16_t, std::int16_t, std::less<std::int16_t>, 4>(rng);
+	packed<std::uint8_t, std::int8_t, std::greater<std::int8_t>, 2>(rng);
+	packed<std::uint16_t, std::int8_t, std::less<std::int8_t>, 8>(rng);
+	// 8 byte words
+	packed<std::uint32_t, int, std::greater<int>, 4>(rng);
+	packed<std::uint32_t, int, std::less<int>, 4>(rng);
+	packed<std::uint16_t, int, std::greater<int>, 2>(rng);
+	packed<std::uint8_t, std::int32_t, std::less<std::int32_t>, 8>(rng);
+	return checkResult("packed_pq");
+}
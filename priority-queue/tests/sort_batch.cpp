@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sort.cpp>
+#include <check.hh>
+
+/*
+ * The batch mode of examples/sort.cpp. parseInts is checked on edge
+ * tokens, on text split into blocks at every offset (the pipe path),
+ * and against a plain stoi parse of random text that hits both the
+ * eight digit loads and the byte loop. runBatch sorts a temp file and
+ * its stdout has to match std::sort.
+ */
+
+std::vector<int> parseAll(const std::string& text, std::size_t& bad) {
+	std::vector<int> out;
+	bad = 0;
+	parseInts(text.data(), text.data() + text.size(), true, out, bad);
+	return out;
+}
+
+// text fed in two blocks split at cut, carrying the unparsed tail over like runBatch
+std::vector<int> parseSplit(const std::string& text, std::size_t cut, std::size_t& bad) {
+	std::vector<int> out;
+	bad = 0;
+	const char* stop = parseInts(text.data(), text.data() + cut, false, out, bad);
+	std::string rest(stop, text.data() + text.size());
+	parseInts(rest.data(), rest.data() + rest.size(), true, out, bad);
+	return out;
+}
+
+std::string randomText(std::size_t count, std::vector<int>& expect, std::mt19937& rng) {
+	static const char* SEPARATORS[] = {" ", "\n", ",", "\r\n", "\t", ", "};
+	std::uniform_int_distribution<int> wide(-2147483647 - 1, 2147483647);
+	std::uniform_int_distribution<int> narrow(-999, 999);
+	std::string text;
+	for (std::size_t i = 0; i < count; i++) {
+		int v = rng() % 2 ? wide(rng) : narrow(rng);
+		expect.push_back(v);
+		text += std::to_string(v);
+		text += SEPARATORS[rng() % 6];
+	}
+	return text;
+}
+
+void tokens() {
+	std::size_t bad;
+	CHECK(parseAll("2147483647 -2147483648 0 -0 007", bad) ==
+		std::vector<int>({2147483647, -2147483647 - 1, 0, 0, 7}) && bad == 0);
+	CHECK(parseAll("2147483648 -2147483649 99999999999999999999", bad).empty() && bad == 3);
+	CHECK(parseAll("12a 3 - -x 4.5 ,,5,", bad) == std::vector<int>({3, 5}) && bad == 4);
+	// long enough for the 64 bit loads on every token
+	CHECK(parseAll("1234567890 12345678 123456789 -1234567890 1,2,3,4,5,6,7,8", bad) ==
+		std::vector<int>({1234567890, 12345678, 123456789, -1234567890, 1, 2, 3, 4, 5, 6, 7, 8})
+		&& bad == 0);
+	CHECK(parseAll("", bad).empty() && bad == 0);
+}
+
+void splits() {
+	std::mt19937 rng(5);
+	std::vector<int> expect;
+	std::string text = randomText(40, expect, rng) + "oops 17";
+	expect.push_back(17);
+	bool same = true;
+	for (std::size_t cut = 0; cut <= text.size(); cut++) {
+		std::size_t bad;
+		same = same && parseSplit(text, cut, bad) == expect && bad == 1;
+	}
+	CHECK(same);
+}
+
+std::string readFile(int fd) {
+	std::string out;
+	char buf[1 << 16];
+	lseek(fd, 0, SEEK_SET);
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		out.append(buf, n);
+	}
+	return out;
+}
+
+int lowestFreeFd() {
+	int fd = dup(STDIN_FILENO);
+	close(fd);
+	return fd;
+}
+
+int tempFile() {
+	char path[] = "/tmp/sort_batchXXXXXX";
+	int fd = mkstemp(path);
+	unlink(path);
+	return fd;
+}
+
+void batch() {
+	std::mt19937 rng(11);
+	std::vector<int> nums;
+	std::string text = randomText(200000, nums, rng);
+	std::sort(nums.begin(), nums.end(), std::greater<int>());
+	std::string expect;
+	for (int v : nums) {
+		expect += std::to_string(v) + "\n";
+	}
+
+	int in = tempFile();
+	int out = tempFile();
+	int quiet = open("/dev/null", O_WRONLY);
+	CHECK(in >= 0 && out >= 0 && quiet >= 0);
+	writeAll(in, text.data(), text.size());
+
+	// runBatch writes to the real stdout and its timings to stderr
+	std::fflush(stdout);
+	int savedOut = dup(STDOUT_FILENO);
+	int savedErr = dup(STDERR_FILENO);
+	dup2(out, STDOUT_FILENO);
+	dup2(quiet, STDERR_FILENO);
+	int status = runBatch(("/proc/self/fd/" + std::to_string(in)).c_str());
+	int missing = runBatch("/nonexistent/sort_batch");
+	// a directory opens but fails to read, and must not leak its fd
+	int before = lowestFreeFd();
+	int unreadable = runBatch("/tmp");
+	int after = lowestFreeFd();
+	dup2(savedOut, STDOUT_FILENO);
+	dup2(savedErr, STDERR_FILENO);
+
+	CHECK(status == 0);
+	CHECK(readFile(out) == expect);
+	CHECK(missing == 1);
+	CHECK(unreadable == 1 && after == before);
+	close(savedOut);
+	close(savedErr);
+	close(quiet);
+	close(out);
+	close(in);
+}
+
+int main() {
+	tokens();
+	splits();
+	batch();
+	return checkResult("sort_batch");
+}
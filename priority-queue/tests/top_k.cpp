@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+#include <top_k.hh>
+#include <check.hh>
+
+/*
+ * TopK against a full sort of the stream. Keys are drawn from a small
+ * range so there are plenty of ties at the threshold. Which of several
+ * equal items survives is not specified, so keys are compared as sorted
+ * lists and each payload is checked against the key it was offered with.
+ */
+
+std::vector<int> streamKeys(int n, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> keys(0, n / 4);
+	std::vector<int> out(n);
+	for (int& k : out) {
+		k = keys(rng);
+	}
+	return out;
+}
+
+template<typename Compare>
+std::vector<int> expectedKeys(std::vector<int> keys, std::size_t k) {
+	std::sort(keys.begin(), keys.end(), Compare());
+	keys.resize(std::min(k, keys.size()));
+	return keys;
+}
+
+// payload i was offered with keys[i]
+template<typename Compare>
+bool matches(const std::vector<std::pair<int, int> >& got, const std::vector<int>& keys,
+	const std::vector<int>& expect) {
+	if (got.size() != expect.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < got.size(); i++) {
+		if (got[i].second != expect[i] || keys[got[i].first] != got[i].second) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename Compare>
+void stream(std::size_t k, int n) {
+	std::vector<int> keys = streamKeys(n, k);
+	TopK<int, int, Compare> top(k);
+	for (int i = 0; i < n; i++) {
+		top.offer(i, keys[i]);
+	}
+	std::vector<int> expect = expectedKeys<Compare>(keys, k);
+	CHECK(top.isFull() == (static_cast<std::size_t>(n) >= k));
+	if (!expect.empty()) {
+		CHECK(top.threshold() == expect.back());
+	}
+	CHECK(matches<Compare>(top.drainSorted(), keys, expect));
+	CHECK(top.isEmpty() && !top.isFull());
+}
+
+// four partial sets merged into one give the top k of the whole stream
+void merge() {
+	const std::size_t k = 100;
+	const int n = 20000;
+	std::vector<int> keys = streamKeys(n, 99);
+	std::vector<TopK<int> > parts(4, TopK<int>(k));
+	for (int i = 0; i < n; i++) {
+		parts[i % 4].offer(i, keys[i]);
+	}
+
+	TopK<int> byMove(k);
+	TopK<int> byCopy(k);
+	for (TopK<int>& part : parts) {
+		byCopy.mergeFrom(part);
+		CHECK(part.count() == static_cast<int>(k));
+	}
+	for (TopK<int>& part : parts) {
+		byMove.mergeFrom(std::move(part));
+		CHECK(part.isEmpty() && !part.isFull());
+	}
+	// merging into itself changes nothing
+	byMove.mergeFrom(std::move(byMove));
+	CHECK(byMove.count() == static_cast<int>(k));
+
+	std::vector<int> expect = expectedKeys<std::greater<int> >(keys, k);
+	CHECK(matches<std::greater<int> >(byMove.drainSorted(), keys, expect));
+	CHECK(matches<std::greater<int> >(byCopy.drainSorted(), keys, expect));
+}
+
+void edges() {
+	CHECK_THROWS(TopK<int>(0), std::invalid_argument);
+	TopK<int> top(3);
+	CHECK_THROWS(top.threshold(), std::out_of_range);
+	CHECK_THROWS(top.worst(), std::out_of_range);
+
+	// ties with the threshold are rejected once full
+	CHECK(top.offer(1, 5));
+	CHECK(top.offer(2, 5));
+	CHECK(top.offer(3, 5));
+	CHECK(!top.offer(4, 5));
+	CHECK(top.offer(5, 6));
+	CHECK(top.threshold() == 5);
+
+	// move only payloads go through offer(T&&)
+	TopK<std::unique_ptr<int> > owners(2);
+	for (int i = 0; i < 10; i++) {
+		owners.offer(std::make_unique<int>(i), i);
+	}
+	std::vector<std::pair<std::unique_ptr<int>, int> > best = owners.drainSorted();
+	CHECK(best.size() == 2 && *best[0].first == 9 && *best[1].first == 8);
+}
+
+int main() {
+	stream<std::greater<int> >(1, 1000);
+	stream<std::greater<int> >(64, 50000);
+	stream<std::less<int> >(64, 50000);
+	stream<std::greater<int> >(500, 300);
+	merge();
+	edges();
+	return checkResult("top_k");
+}